@@ -0,0 +1,124 @@
+/*
+Synthetic dataset generator for benchmarking, writing csv files in the format read by
+'random-forest' (a header line, then rows of features with the target in the last column) of any
+size, far beyond the 568 rows of wdbc.csv. The rows are those of 'synth_row', so a dataset only
+depends on its options and the seed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+
+struct GenOptions
+{
+    const char *out;
+    long rows;
+    long cols; // Features plus the target column.
+    long classes;
+    long informative;
+    double separation; // Spread of the class centers, in units of the noise.
+    int regression;
+    unsigned int seed;
+};
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s <OUT_CSV> --rows N --cols N [--classes K] [--informative N] [--separation X]\n"
+           " [--regression] [--seed N]\n"
+           "  --rows N          Rows of the dataset\n"
+           "  --cols N          Columns, including the target in the last one (>= 2)\n"
+           "  --classes K       Classes of a classification dataset (default: 2)\n"
+           "  --informative N   Features that carry the target, the others are noise\n"
+           "                    (default: half of the features, at least 1)\n"
+           "  --separation X    Standard deviation of the class centers (default: 0.3)\n"
+           "  --regression      Write real valued targets instead of classes\n"
+           "  --seed N          Seed of the generator (default: 1)\n",
+           prog);
+    exit(1);
+}
+
+static struct GenOptions parse_gen_args(int argc, char **argv)
+{
+    struct GenOptions o = {.out = NULL, .rows = 0, .cols = 0, .classes = 2, .informative = 0,
+                           .separation = 0.3, .regression = 0, .seed = 1};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+            o.rows = atol(argv[++i]);
+        else if (strcmp(argv[i], "--cols") == 0 && i + 1 < argc)
+            o.cols = atol(argv[++i]);
+        else if (strcmp(argv[i], "--classes") == 0 && i + 1 < argc)
+            o.classes = atol(argv[++i]);
+        else if (strcmp(argv[i], "--informative") == 0 && i + 1 < argc)
+            o.informative = atol(argv[++i]);
+        else if (strcmp(argv[i], "--separation") == 0 && i + 1 < argc)
+            o.separation = atof(argv[++i]);
+        else if (strcmp(argv[i], "--regression") == 0)
+            o.regression = 1;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            o.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (o.out == NULL && argv[i][0] != '-')
+            o.out = argv[i];
+        else
+        {
+            printf("Error: unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+        }
+    }
+
+    if (o.out == NULL || o.rows < 1 || o.cols < 2)
+        usage(argv[0]);
+    if (o.informative == 0)
+        o.informative = (o.cols - 1) / 2 > 0 ? (o.cols - 1) / 2 : 1;
+    if (o.informative < 1 || o.informative > o.cols - 1 || (!o.regression && (o.classes < 2 || o.classes > 255)))
+    {
+        printf("Error: --informative must be in [1, %ld] and --classes in [2, 255], got: %ld and %ld\n",
+               o.cols - 1, o.informative, o.classes);
+        exit(1);
+    }
+    return o;
+}
+
+int main(int argc, char **argv)
+{
+    struct GenOptions o = parse_gen_args(argc, argv);
+    long n_features = o.cols - 1;
+
+    FILE *out = fopen(o.out, "w");
+    if (out == NULL)
+    {
+        printf("Error: can't create file: %s\n", o.out);
+        return 1;
+    }
+
+    SynthSpec spec = synth_create(o.cols, o.classes, o.informative, o.separation, o.regression, o.seed);
+
+    // 'random-forest' skips the first line (see CSV_HAS_HEADER).
+    for (long f = 0; f < n_features; ++f)
+        fprintf(out, "f%ld,", f);
+    fprintf(out, "target\n");
+
+    double *row = malloc(o.cols * sizeof(double));
+    for (long r = 0; r < o.rows; ++r)
+    {
+        synth_row(&spec, r, row);
+
+        for (long f = 0; f < n_features; ++f)
+            fprintf(out, "%.6g,", row[f]);
+        if (o.regression)
+            fprintf(out, "%.6g\n", row[n_features]);
+        else
+            fprintf(out, "%ld\n", (long)row[n_features]);
+    }
+
+    free(row);
+    synth_free(&spec);
+    if (fclose(out) != 0)
+    {
+        printf("Error: failed to write file: %s\n", o.out);
+        return 1;
+    }
+    return 0;
+}
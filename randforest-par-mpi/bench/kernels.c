@@ -0,0 +1,515 @@
+/*
+Microbenchmarks of the hot kernels of training and evaluation, timed in isolation on synthetic rows
+(see 'synth_row') or on the rows of a csv file:
+
+  partition      'partition_rows' of every row on one feature
+  split_dataset  'split_dataset', the partition plus the allocation of the halves
+  gini           'gini_from_counts' of a node's class counts
+  best_split     'calculate_best_data_split' of a root node, trying every distinct value
+  best_split_q   the same with the quantile thresholds of large nodes (the default of random-forest)
+  best_split_x   the same with the random thresholds of --extra_trees
+  predict_row    'make_prediction' of every row by one tree
+  predict_batch  'predict_model_batch' of every row by the whole forest
+  parse_csv      'parse_csv_dims' and 'parse_csv' of the rows written out as csv
+
+Every kernel runs 'warmup' untimed times and then 'repeats' timed times. The median, minimum and
+relative standard deviation of the timed runs are reported, with the median time and, given
+--perf_counters, the median cycles per unit of work (a row, or a call of 'gini_from_counts'), so a
+change to 'model/tree.c' can be judged in seconds instead of through a whole cross validation.
+*/
+
+// mkstemp is POSIX.
+#define _XOPEN_SOURCE 700
+
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "synth.h"
+#include "../model/forest.h"
+#include "../model/partition.h"
+#include "../model/tree.h"
+#include "../utils/data.h"
+#include "../utils/perf.h"
+#include "../utils/timer.h"
+
+static const char *kernel_names[] = {"partition", "split_dataset", "gini", "best_split", "best_split_q",
+                                     "best_split_x", "predict_row", "predict_batch", "parse_csv"};
+
+// Calls of 'gini_from_counts' per run, and the distinct class counts they cycle through.
+#define GINI_CALLS (1 << 20)
+#define GINI_COUNT_SETS 256
+
+struct BenchOptions
+{
+    long rows;
+    long cols;
+    long classes;
+    long max_features; // 0: the smaller of 20 and the features.
+    long trees;
+    long depth;
+    long warmup;
+    long repeats;
+    unsigned int seed;
+    const char *csv;     // Rows to benchmark on instead of synthetic ones.
+    const char *kernels; // Comma separated kernels to run, NULL for all.
+    int perf_counters;
+};
+
+/*
+Inputs shared by the kernels, and a sink for their results so the compiler can't drop the calls.
+*/
+struct Bench
+{
+    double **data;
+    size_t rows;
+    size_t cols;
+    size_t n_classes;
+    size_t max_features;
+    unsigned int seed;
+
+    int feature;      // Feature and threshold of the partition kernels.
+    double threshold;
+    double **left;
+    double **right;
+
+    long *gini_counts; // GINI_COUNT_SETS sets of 'n_classes' counts, and the size of each set.
+    size_t *gini_totals;
+
+    const ModelContext *ctx; // Split search variant of 'best_split'.
+
+    const DecisionTreeNode **forest;
+    size_t n_trees;
+    int *predictions;
+
+    const char *csv_file;
+
+    double sink;
+};
+
+typedef void (*Kernel)(struct Bench *b);
+
+/*
+Whether 'name' is one of the comma separated kernels selected with --kernel.
+*/
+static int selected(const struct BenchOptions *o, const char *name)
+{
+    if (o->kernels == NULL)
+        return 1;
+    size_t len = strlen(name);
+    for (const char *k = o->kernels; *k; k += strcspn(k, ","), k += *k == ',')
+    {
+        if (strncmp(k, name, len) == 0 && (k[len] == ',' || k[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+Exits unless every kernel selected with --kernel exists.
+*/
+static void check_kernels(const struct BenchOptions *o)
+{
+    if (o->kernels == NULL)
+        return;
+    for (const char *k = o->kernels; *k; k += strcspn(k, ","), k += *k == ',')
+    {
+        size_t len = strcspn(k, ",");
+        int known = 0;
+        for (size_t i = 0; i < sizeof(kernel_names) / sizeof(kernel_names[0]); ++i)
+            known = known || (strlen(kernel_names[i]) == len && strncmp(k, kernel_names[i], len) == 0);
+        if (!known)
+        {
+            printf("Error: unknown kernel: %.*s\n", (int)len, k);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [--rows N] [--cols N] [--classes K] [--max_features N] [--trees N] [--depth N]\n"
+           " [--warmup N] [--repeats N] [--seed N] [--csv FILE] [--kernel NAME,...] [--perf_counters]\n"
+           "  --rows N          Rows of the synthetic dataset (default: 20000)\n"
+           "  --cols N          Columns, including the target in the last one (default: 33)\n"
+           "  --classes K       Classes of the synthetic dataset (default: 2)\n"
+           "  --max_features N  Features per split (default: the smaller of 20 and the features)\n"
+           "  --trees N         Trees of the forest of the prediction kernels (default: 20)\n"
+           "  --depth N         Maximum depth of those trees (default: 7)\n"
+           "  --warmup N        Untimed runs of every kernel (default: 2)\n"
+           "  --repeats N       Timed runs of every kernel (default: 10)\n"
+           "  --seed N          Seed of the dataset and of the trees (default: 1)\n"
+           "  --csv FILE        Benchmark on the rows of FILE instead of synthetic rows\n"
+           "  --kernel NAME,... Only run these kernels: partition, split_dataset, gini, best_split,\n"
+           "                    best_split_q, best_split_x, predict_row, predict_batch, parse_csv\n"
+           "  --perf_counters   Report cycles per unit of work, read with perf_event_open\n",
+           prog);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+static struct BenchOptions parse_bench_args(int argc, char **argv)
+{
+    struct BenchOptions o = {.rows = 20000, .cols = 33, .classes = 2, .max_features = 0, .trees = 20,
+                             .depth = 7, .warmup = 2, .repeats = 10, .seed = 1, .csv = NULL,
+                             .kernels = NULL, .perf_counters = 0};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+            o.rows = atol(argv[++i]);
+        else if (strcmp(argv[i], "--cols") == 0 && i + 1 < argc)
+            o.cols = atol(argv[++i]);
+        else if (strcmp(argv[i], "--classes") == 0 && i + 1 < argc)
+            o.classes = atol(argv[++i]);
+        else if (strcmp(argv[i], "--max_features") == 0 && i + 1 < argc)
+            o.max_features = atol(argv[++i]);
+        else if (strcmp(argv[i], "--trees") == 0 && i + 1 < argc)
+            o.trees = atol(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            o.depth = atol(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            o.warmup = atol(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+            o.repeats = atol(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            o.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+            o.csv = argv[++i];
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+            o.kernels = argv[++i];
+        else if (strcmp(argv[i], "--perf_counters") == 0)
+            o.perf_counters = 1;
+        else
+        {
+            printf("Error: unknown option: %s\n", argv[i]);
+            usage(argv[0]);
+        }
+    }
+
+    if (o.rows < 2 || o.cols < 2 || o.classes < 2 || o.classes > 255 || o.max_features < 0 ||
+        o.trees < 1 || o.depth < 1 || o.warmup < 0 || o.repeats < 1)
+    {
+        printf("Error: --rows, --cols and --classes must be >= 2 (--classes <= 255), --trees, --depth and\n"
+               "--repeats >= 1, --max_features and --warmup >= 0\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    check_kernels(&o);
+    return o;
+}
+
+static void kernel_partition(struct Bench *b)
+{
+    b->sink += (double)partition_rows(b->data, b->rows, b->feature, b->threshold, b->left, b->right);
+}
+
+static void kernel_split_dataset(struct Bench *b)
+{
+    DecisionTreeData *halves = split_dataset(b->feature, b->threshold, b->data, b->rows, b->cols);
+    b->sink += (double)halves[0].length;
+    free_decision_tree_data(halves);
+}
+
+static void kernel_gini(struct Bench *b)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < GINI_CALLS; ++i)
+    {
+        size_t set = i % GINI_COUNT_SETS;
+        sum += gini_from_counts(b->gini_counts + set * b->n_classes, b->n_classes, b->gini_totals[set]);
+    }
+    b->sink += sum;
+}
+
+static void kernel_best_split(struct Bench *b)
+{
+    // The same features every run, as if the same node were split again.
+    RandomState rng;
+    rng_init(&rng, b->seed, 0, 0, 0);
+    TreeStats stats = {0};
+
+    DecisionTreeDataSplit split = calculate_best_data_split(b->data, NULL, b->max_features, b->rows, b->cols,
+                                                            b->ctx, &stats, &rng);
+    b->sink += split.gini;
+    if (split.data != NULL)
+        free_decision_tree_data(split.data);
+}
+
+static void kernel_predict_row(struct Bench *b)
+{
+    long sum = 0;
+    for (size_t r = 0; r < b->rows; ++r)
+    {
+        int prediction;
+        make_prediction(b->forest[0], b->data[r], &prediction);
+        sum += prediction;
+    }
+    b->sink += (double)sum;
+}
+
+static void kernel_predict_batch(struct Bench *b)
+{
+    predict_model_batch(&b->forest, b->n_trees, b->n_classes, b->data, b->rows, b->predictions);
+    b->sink += (double)b->predictions[b->rows / 2];
+}
+
+static void kernel_parse_csv(struct Bench *b)
+{
+    struct dim dim = parse_csv_dims(b->csv_file);
+    double *values = malloc(dim.rows * dim.cols * sizeof(double));
+    parse_csv(b->csv_file, &values, dim);
+    b->sink += values[dim.rows * dim.cols - 1];
+    free(values);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *values, long n)
+{
+    qsort(values, n, sizeof(double), compare_doubles);
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+/*
+Runs 'kernel' 'o->warmup' times, then times 'o->repeats' runs of it and prints one line of the
+report, normalized by the 'units' of work each run does.
+*/
+static void run_kernel(const struct BenchOptions *o, struct Bench *b, const char *name, Kernel kernel,
+                       double units, const char *unit)
+{
+    if (!selected(o, name))
+        return;
+
+    for (long i = 0; i < o->warmup; ++i)
+        kernel(b);
+
+    double *ns = malloc(o->repeats * sizeof(double));
+    double *cycles = malloc(o->repeats * sizeof(double));
+    int counted = 1;
+    for (long i = 0; i < o->repeats; ++i)
+    {
+        PerfSample before, after;
+        int64_t start = timer_now();
+        perf_begin(&before);
+        kernel(b);
+        perf_begin(&after);
+        ns[i] = (double)(timer_now() - start);
+
+        counted = counted && before.valid && after.valid;
+        if (counted)
+            cycles[i] = perf_delta(&before, &after, PERF_CYCLES);
+    }
+
+    double sum = 0.0, ss = 0.0, min = ns[0];
+    for (long i = 0; i < o->repeats; ++i)
+    {
+        sum += ns[i];
+        min = ns[i] < min ? ns[i] : min;
+    }
+    double mean = sum / o->repeats;
+    for (long i = 0; i < o->repeats; ++i)
+        ss += (ns[i] - mean) * (ns[i] - mean);
+    double rsd = o->repeats > 1 ? 100.0 * sqrt(ss / (o->repeats - 1)) / mean : 0.0;
+    double median_ns = median(ns, o->repeats);
+
+    printf("%-14s %12.3f %12.3f %7.2f %12.2f ", name, median_ns / 1e6, min / 1e6, rsd, median_ns / units);
+    if (counted)
+        printf("%12.2f", median(cycles, o->repeats) / units);
+    else
+        printf("%12s", "-");
+    printf("  per %s\n", unit);
+    fflush(stdout);
+
+    free(ns);
+    free(cycles);
+}
+
+/*
+Writes the 'rows' rows of 'data' to a new temporary csv file in the format of 'gen-data' and returns
+its path, which the caller removes and frees.
+*/
+static char *write_temp_csv(double **data, size_t rows, size_t cols)
+{
+    const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char *path = malloc(strlen(dir) + sizeof("/rf-kernels-XXXXXX"));
+    sprintf(path, "%s/rf-kernels-XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (out == NULL)
+    {
+        printf("Error: can't create temporary csv file: %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // 'parse_csv' skips the first line (see CSV_HAS_HEADER).
+    for (size_t f = 0; f < cols - 1; ++f)
+        fprintf(out, "f%zu,", f);
+    fprintf(out, "target\n");
+    for (size_t r = 0; r < rows; ++r)
+    {
+        for (size_t f = 0; f < cols - 1; ++f)
+            fprintf(out, "%.6g,", data[r][f]);
+        fprintf(out, "%ld\n", (long)data[r][cols - 1]);
+    }
+
+    if (fclose(out) != 0)
+    {
+        printf("Error: failed to write temporary csv file: %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return path;
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (size != 1)
+    {
+        printf("Error: the kernels are benchmarked on a single process, got %d\n", size);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    struct BenchOptions o = parse_bench_args(argc, argv);
+    set_log_level(0);
+    if (o.perf_counters)
+        perf_enable(0);
+
+    // The dataset, from the csv file or synthetic.
+    struct dim dim;
+    double **data;
+    if (o.csv != NULL)
+    {
+        dim = parse_csv_dims(o.csv);
+        double *values = malloc(dim.rows * dim.cols * sizeof(double));
+        parse_csv(o.csv, &values, dim);
+        pivot_data(values, dim, &data);
+        free(values);
+    }
+    else
+    {
+        dim = (struct dim){.rows = (size_t)o.rows, .cols = (size_t)o.cols};
+        data = _2d_calloc(dim.rows, dim.cols);
+        long informative = (o.cols - 1) / 2 > 0 ? (o.cols - 1) / 2 : 1;
+        SynthSpec spec = synth_create(o.cols, o.classes, informative, 0.3, 0, o.seed);
+        for (long r = 0; r < o.rows; ++r)
+            synth_row(&spec, r, data[r]);
+        synth_free(&spec);
+    }
+
+    size_t n_features = dim.cols - 1;
+    size_t max_features = o.max_features > 0 ? (size_t)o.max_features : (n_features < 20 ? n_features : 20);
+    if (max_features > n_features)
+    {
+        printf("Error: --max_features must be at most %zu (the columns but the target), got: %zu\n",
+               n_features, max_features);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    struct Bench b = {.data = data, .rows = dim.rows, .cols = dim.cols,
+                      .n_classes = count_classes(data, dim.rows, dim.cols), .max_features = max_features,
+                      .seed = o.seed, .feature = 0, .threshold = data[dim.rows / 2][0]};
+
+    // Contexts that train on every row: no row falls into testing fold 1 of 'rows' rows per fold.
+    const ModelContext exact_ctx = {.testingFoldIdx = 1, .rowsPerFold = dim.rows, .n_classes = b.n_classes};
+    const ModelContext quantile_ctx = {.testingFoldIdx = 1, .rowsPerFold = dim.rows, .n_classes = b.n_classes,
+                                       .quantile_rows = 4096, .n_quantiles = 256};
+    const ModelContext extra_ctx = {.testingFoldIdx = 1, .rowsPerFold = dim.rows, .n_classes = b.n_classes,
+                                    .extra_trees = 1};
+
+    printf("%zu rows x %zu cols, %zu classes, %zu features per split, partition kernel %s\n",
+           dim.rows, dim.cols, b.n_classes, max_features, partition_kernel_name());
+    printf("%-14s %12s %12s %7s %12s %12s\n", "kernel", "median ms", "min ms", "rsd %", "ns/unit", "cycles/unit");
+
+    b.left = malloc(dim.rows * sizeof(double *));
+    b.right = malloc(dim.rows * sizeof(double *));
+    run_kernel(&o, &b, "partition", kernel_partition, (double)dim.rows, "row");
+    run_kernel(&o, &b, "split_dataset", kernel_split_dataset, (double)dim.rows, "row");
+
+    // Class counts of nodes of up to 1000 rows.
+    b.gini_counts = malloc(GINI_COUNT_SETS * b.n_classes * sizeof(long));
+    b.gini_totals = calloc(GINI_COUNT_SETS, sizeof(size_t));
+    RandomState count_rng;
+    rng_init(&count_rng, o.seed, 1, 0, 0);
+    for (size_t s = 0; s < GINI_COUNT_SETS; ++s)
+    {
+        for (size_t c = 0; c < b.n_classes; ++c)
+        {
+            b.gini_counts[s * b.n_classes + c] = (long)(rng_next(&count_rng) % (1000 / b.n_classes + 1));
+            b.gini_totals[s] += (size_t)b.gini_counts[s * b.n_classes + c];
+        }
+    }
+    run_kernel(&o, &b, "gini", kernel_gini, (double)GINI_CALLS, "call");
+
+    reserve_split_scratch(max_features, dim.rows, b.n_classes);
+    b.ctx = &exact_ctx;
+    run_kernel(&o, &b, "best_split", kernel_best_split, (double)dim.rows, "row");
+    b.ctx = &quantile_ctx;
+    run_kernel(&o, &b, "best_split_q", kernel_best_split, (double)dim.rows, "row");
+    b.ctx = &extra_ctx;
+    run_kernel(&o, &b, "best_split_x", kernel_best_split, (double)dim.rows, "row");
+
+    // A forest trained on all rows the way 'train_model' builds its trees.
+    if (selected(&o, "predict_row") || selected(&o, "predict_batch"))
+    {
+        RandomForestParameters params = {.n_estimators = (size_t)o.trees, .max_depth = (size_t)o.depth,
+                                         .min_samples_leaf = 3, .max_features = max_features,
+                                         .seed = o.seed, .n_classes = b.n_classes,
+                                         .quantile_rows = 4096, .n_quantiles = 256};
+        b.n_trees = (size_t)o.trees;
+        b.forest = malloc(b.n_trees * sizeof(DecisionTreeNode *));
+        for (size_t t = 0; t < b.n_trees; ++t)
+        {
+            NodeArena arena;
+            RandomState rng;
+            node_arena_init(&arena);
+            rng_init(&rng, o.seed, 0, (uint32_t)t, 0);
+            b.forest[t] = train_model_tree(data, &params, &dim, &arena, &quantile_ctx, &rng);
+            node_arena_finish(&arena);
+        }
+        b.predictions = malloc(dim.rows * sizeof(int));
+
+        run_kernel(&o, &b, "predict_row", kernel_predict_row, (double)dim.rows, "row and tree");
+        run_kernel(&o, &b, "predict_batch", kernel_predict_batch, (double)dim.rows, "row of the forest");
+
+        long freeCount = 0;
+        for (size_t t = 0; t < b.n_trees; ++t)
+            free_decision_tree_node(b.forest[t], &freeCount);
+        free(b.forest);
+        free(b.predictions);
+    }
+
+    if (selected(&o, "parse_csv"))
+    {
+        char *temp_csv = o.csv ? NULL : write_temp_csv(data, dim.rows, dim.cols);
+        b.csv_file = o.csv ? o.csv : temp_csv;
+        run_kernel(&o, &b, "parse_csv", kernel_parse_csv, (double)dim.rows, "row");
+        if (temp_csv != NULL)
+        {
+            unlink(temp_csv);
+            free(temp_csv);
+        }
+    }
+
+    // Keeps the results of the kernels alive.
+    if (b.sink == 42.0)
+        printf("\n");
+
+    release_split_scratch();
+    free(b.left);
+    free(b.right);
+    free(b.gini_counts);
+    free(b.gini_totals);
+    free(data);
+
+    MPI_Finalize();
+    return 0;
+}
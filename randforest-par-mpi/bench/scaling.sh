@@ -0,0 +1,215 @@
+#!/usr/bin/env bash
+#
+# Strong and weak scaling benchmark of random-forest, following the method of the README: every
+# configuration runs 'repeats' times per process count with a pause between runs, and the mean
+# wall time, its RSD, the speedup and the efficiency are written as CSV and as Markdown tables like
+# Tables 2 and 3. Datasets are synthetic (bench/gen-data), generated once per size and reused.
+#
+# Strong scaling keeps the problem fixed while the processes grow. Weak scaling grows the trees
+# (or with '--weak_scale rows' the rows) with the processes, so the listed sizes are per process.
+# Speedup and efficiency are relative to the smallest process count of '--ranks'.
+
+set -euo pipefail
+
+BENCH_DIR="$(cd "$(dirname "$0")" && pwd)"
+ROOT_DIR="$(dirname "$BENCH_DIR")"
+
+mode=strong
+ranks="1 2 4 8"
+rows_list="100000"
+cols_list="33"
+trees_list="20"
+depth_list="7"
+weak_scale=trees
+repeats=3
+pause=5
+classes=2
+k_folds=5
+max_features=""
+seed=1
+data_dir="$BENCH_DIR/data"
+out="$BENCH_DIR/results/scaling"
+mpirun_cmd="mpirun"
+extra_args=()
+
+usage() {
+    cat <<EOF
+Usage: $0 [options] [-- random-forest options]
+  --mode strong|weak    Scaling experiment (default: $mode)
+  --ranks "N ..."       Process counts (default: "$ranks")
+  --rows "N ..."        Dataset rows, per process when weak scaling rows (default: "$rows_list")
+  --cols "N ..."        Dataset columns including the target (default: "$cols_list")
+  --trees "N ..."       Trees, per process when weak scaling trees (default: "$trees_list")
+  --depth "N ..."       Maximum tree depth (default: "$depth_list")
+  --weak_scale W        What grows with the processes when weak scaling: trees or rows (default: $weak_scale)
+  --repeats N           Runs per configuration and process count (default: $repeats)
+  --pause S             Seconds between runs (default: $pause)
+  --classes K           Classes of the synthetic datasets (default: $classes)
+  --k_folds N           Cross validation folds (default: $k_folds)
+  --max_features N      Features per split (default: the smaller of 20 and the features)
+  --seed N              Seed of the datasets and of the forest (default: $seed)
+  --data_dir DIR        Where the datasets are kept (default: bench/data)
+  --out PREFIX          Writes PREFIX.csv and PREFIX.md (default: bench/results/scaling)
+  --mpirun "CMD"        MPI launcher and its options, e.g. "mpirun --hostfile cluster.OPENMPI"
+EOF
+    exit 1
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --mode) mode="$2"; shift 2 ;;
+        --ranks) ranks="$2"; shift 2 ;;
+        --rows) rows_list="$2"; shift 2 ;;
+        --cols) cols_list="$2"; shift 2 ;;
+        --trees) trees_list="$2"; shift 2 ;;
+        --depth) depth_list="$2"; shift 2 ;;
+        --weak_scale) weak_scale="$2"; shift 2 ;;
+        --repeats) repeats="$2"; shift 2 ;;
+        --pause) pause="$2"; shift 2 ;;
+        --classes) classes="$2"; shift 2 ;;
+        --k_folds) k_folds="$2"; shift 2 ;;
+        --max_features) max_features="$2"; shift 2 ;;
+        --seed) seed="$2"; shift 2 ;;
+        --data_dir) data_dir="$2"; shift 2 ;;
+        --out) out="$2"; shift 2 ;;
+        --mpirun) mpirun_cmd="$2"; shift 2 ;;
+        --) shift; extra_args=("$@"); break ;;
+        *) usage ;;
+    esac
+done
+
+if [ "$mode" != strong ] && [ "$mode" != weak ]; then
+    echo "Error: --mode must be strong or weak, got: $mode"
+    exit 1
+fi
+if [ "$weak_scale" != trees ] && [ "$weak_scale" != rows ]; then
+    echo "Error: --weak_scale must be trees or rows, got: $weak_scale"
+    exit 1
+fi
+
+# Process counts in increasing order; the first one is the baseline.
+ranks="$(echo $ranks | tr ' ' '\n' | sort -n | tr '\n' ' ')"
+base_ranks="${ranks%% *}"
+
+make -C "$ROOT_DIR" random-forest bench/gen-data >/dev/null
+mkdir -p "$data_dir" "$(dirname "$out")"
+
+# Prints the path of the synthetic dataset of $1 rows and $2 columns, generating it if needed.
+dataset() {
+    local file="$data_dir/synth-r$1-c$2-k$classes-s$seed.csv"
+    if [ ! -f "$file" ]; then
+        echo "generating $file" >&2
+        "$ROOT_DIR/bench/gen-data" "$file" --rows "$1" --cols "$2" --classes "$classes" --seed "$seed" >&2
+    fi
+    echo "$file"
+}
+
+# Runs random-forest on $2 processes with dataset $1, $3 trees, depth $4 and $5 features per split,
+# and prints its wall time.
+run_once() {
+    local log
+    log="$(mktemp)"
+    if ! (cd "$ROOT_DIR" && $mpirun_cmd -np "$2" ./random-forest "$1" --seed "$seed" --log_level 0 \
+            --n_estimators "$3" --max_depth "$4" --max_features "$5" --k_folds "$k_folds" \
+            ${extra_args[@]+"${extra_args[@]}"}) >"$log" 2>&1; then
+        echo "Error: random-forest failed on $2 processes, see $log" >&2
+        exit 1
+    fi
+    local seconds
+    seconds="$(sed -n 's/^(time taken: \([0-9.]*\)s)$/\1/p' "$log")"
+    if [ -z "$seconds" ]; then
+        echo "Error: no time taken in the output of random-forest, see $log" >&2
+        exit 1
+    fi
+    rm -f "$log"
+    echo "$seconds"
+}
+
+echo "mode,ranks,rows,cols,trees,depth,runs,mean_s,rsd_pct,speedup,efficiency_pct,times_s" >"$out.csv"
+echo "# random-forest $mode scaling" >"$out.md"
+
+first_run=1
+for rows in $rows_list; do
+for cols in $cols_list; do
+for trees in $trees_list; do
+for depth in $depth_list; do
+    features="${max_features:-$(( cols - 1 < 20 ? cols - 1 : 20 ))}"
+    means=()
+    rsds=()
+    speedups=()
+    efficiencies=()
+
+    for n in $ranks; do
+        run_rows=$rows
+        run_trees=$trees
+        if [ "$mode" = weak ] && [ "$weak_scale" = rows ]; then
+            run_rows=$(( rows * n ))
+        elif [ "$mode" = weak ]; then
+            run_trees=$(( trees * n ))
+        fi
+        data="$(dataset "$run_rows" "$cols")"
+
+        times=()
+        for (( r = 0; r < repeats; ++r )); do
+            [ "$first_run" = 1 ] || sleep "$pause"
+            first_run=0
+            times+=("$(run_once "$data" "$n" "$run_trees" "$depth" "$features")")
+            echo "$mode N=$n rows=$run_rows cols=$cols trees=$run_trees depth=$depth run $(( r + 1 )): ${times[-1]} s" >&2
+        done
+
+        # Mean and relative standard deviation (sample) of the runs.
+        read -r mean rsd < <(printf '%s\n' "${times[@]}" | awk '
+            { x[NR] = $1; sum += $1 }
+            END {
+                mean = sum / NR
+                for (i = 1; i <= NR; ++i) ss += (x[i] - mean) ^ 2
+                sd = NR > 1 ? sqrt(ss / (NR - 1)) : 0
+                printf "%.6f %.2f\n", mean, (mean > 0 ? 100 * sd / mean : 0)
+            }')
+        means+=("$mean")
+        rsds+=("$rsd")
+
+        # Strong: S = N0 * T(N0) / T(N) and E = S / N. Weak: E = T(N0) / T(N) and the scaled speedup
+        # S = N * E.
+        read -r speedup efficiency < <(awk -v t0="${means[0]}" -v t="$mean" -v n0="$base_ranks" -v n="$n" -v mode="$mode" '
+            BEGIN {
+                if (mode == "strong") { s = n0 * t0 / t; e = 100 * s / n }
+                else { e = 100 * t0 / t; s = n * e / 100 }
+                printf "%.2f %.2f\n", s, e
+            }')
+        speedups+=("$speedup")
+        efficiencies+=("$efficiency")
+
+        echo "$mode,$n,$run_rows,$cols,$run_trees,$depth,$repeats,$mean,$rsd,$speedup,$efficiency,$(IFS=';'; echo "${times[*]}")" >>"$out.csv"
+    done
+
+    # One Markdown table per configuration, process counts as columns.
+    size="fixed problem"
+    [ "$mode" = strong ] || size="$weak_scale per process"
+    {
+        echo
+        echo "## rows=$rows cols=$cols trees=$trees depth=$depth ($size, $repeats runs)"
+        echo
+        printf '| N |'; printf ' %s |' $ranks; echo
+        printf '| :-- |'; for n in $ranks; do printf ' :-- |'; done; echo
+        printf '| **T_R (s)** |'; printf ' %.2f |' "${means[@]}"; echo
+        printf '| **RSD (%%)** |'
+        for rsd in "${rsds[@]}"; do
+            printf ' %s%s |' "$rsd" "$(awk -v r="$rsd" 'BEGIN { if (r + 0 > 10) printf " ⚠️" }')"
+        done
+        echo
+        printf '| **S_R** |'; printf ' %sx |' "${speedups[@]}"; echo
+        printf '| **E_R (%%)** |'; printf ' %s |' "${efficiencies[@]}"; echo
+    } >>"$out.md"
+done
+done
+done
+done
+
+{
+    echo
+    echo "S_R: speedup over $base_ranks process(es), E_R: efficiency. ⚠️ marks an RSD above 10%, which the"
+    echo "README's method discards."
+} >>"$out.md"
+
+echo "wrote $out.csv and $out.md" >&2
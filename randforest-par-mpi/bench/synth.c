@@ -0,0 +1,73 @@
+/*
+Synthetic rows for the benchmarks.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include "synth.h"
+#include "../utils/rng.h"
+
+#define PI 3.14159265358979323846
+
+// Stream of the class centers and the regression weights, kept apart from the row streams.
+#define PARAMS_STREAM 0xFFFFFFFFu
+
+/*
+Uniform number in (0, 1].
+*/
+static double next_uniform(RandomState *rng)
+{
+    return ((double)rng_next(rng) + 1.0) / 4294967296.0;
+}
+
+/*
+Standard normal number, with the Box-Muller transform.
+*/
+static double next_gaussian(RandomState *rng)
+{
+    double u = next_uniform(rng);
+    double v = next_uniform(rng);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * PI * v);
+}
+
+SynthSpec synth_create(long cols, long classes, long informative, double separation, int regression, unsigned int seed)
+{
+    SynthSpec spec = {.cols = cols, .classes = classes, .informative = informative,
+                      .separation = separation, .regression = regression, .seed = seed};
+
+    long n_centers = regression ? 1 : classes;
+    spec.centers = malloc(n_centers * informative * sizeof(double));
+    RandomState params_rng;
+    rng_init(&params_rng, seed, PARAMS_STREAM, 0, 0);
+    for (long k = 0; k < n_centers * informative; ++k)
+        spec.centers[k] = separation * next_gaussian(&params_rng);
+    return spec;
+}
+
+void synth_free(SynthSpec *spec)
+{
+    free(spec->centers);
+    spec->centers = NULL;
+}
+
+void synth_row(const SynthSpec *spec, long r, double *row)
+{
+    long n_features = spec->cols - 1;
+    RandomState rng;
+    rng_init(&rng, spec->seed, 0, 0, (uint64_t)r);
+
+    long label = spec->regression ? 0 : (long)(rng_next(&rng) % (uint32_t)spec->classes);
+    const double *center = spec->centers + label * spec->informative;
+    for (long f = 0; f < n_features; ++f)
+        row[f] = (f < spec->informative && !spec->regression ? center[f] : 0.0) + next_gaussian(&rng);
+
+    if (spec->regression)
+    {
+        double y = 0.0;
+        for (long f = 0; f < spec->informative; ++f)
+            y += center[f] * row[f] + sin(row[f]);
+        row[n_features] = y + 0.5 * next_gaussian(&rng);
+    }
+    else
+        row[n_features] = (double)label;
+}
@@ -0,0 +1,44 @@
+/*
+Synthetic rows for the benchmarks, shared by 'gen-data', which writes them to csv files, and
+'kernels', which times the training kernels on them in memory.
+
+Classification rows belong to one of 'classes' classes drawn uniformly. Each class has its own
+center in the space of the first 'informative' features, drawn once from the seed, and a row is its
+class center plus unit gaussian noise; the remaining features are pure noise. The classes overlap, so
+trees keep splitting down to their maximum depth as they do on real data instead of separating the
+classes in a few nodes. Regression rows are all noise, and their target is a weighted sum of a
+linear and a nonlinear term of the informative features plus noise.
+
+Every row is drawn from its own Philox stream (see 'rng_init'), so a row only depends on the options,
+the seed and its index, and any prefix of a larger dataset equals the smaller one.
+*/
+
+#ifndef synth_h
+#define synth_h
+
+struct SynthSpec
+{
+    long cols;         // Features plus the target column.
+    long classes;
+    long informative;  // Features that carry the target, the others are noise.
+    double separation; // Spread of the class centers, in units of the noise.
+    int regression;
+    unsigned int seed;
+    double *centers;   // 'classes' centers, or the regression weights, over the informative features.
+};
+
+typedef struct SynthSpec SynthSpec;
+
+/*
+Draws the class centers, or the regression weights, of a dataset of 'cols' columns from 'seed'.
+*/
+SynthSpec synth_create(long cols, long classes, long informative, double separation, int regression, unsigned int seed);
+
+void synth_free(SynthSpec *spec);
+
+/*
+Writes the 'spec->cols' values of row 'r' to 'row', the class or real valued target last.
+*/
+void synth_row(const SynthSpec *spec, long r, double *row);
+
+#endif // synth_h
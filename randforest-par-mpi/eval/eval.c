@@ -10,8 +10,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
 #include "eval.h"
+#include "../model/presort.h"
 #include "../utils/log.h"
+#include "../utils/timer.h"
+#include "../utils/perf.h"
 
 void hyperparameter_search(double **data, struct dim *csv_dim)
 {
@@ -39,6 +44,9 @@ void hyperparameter_search(double **data, struct dim *csv_dim)
     // Number of folds for cross validation.
     size_t k_folds = 5;
 
+    // Class targets of the dataset.
+    size_t n_classes = count_classes(data, csv_dim->rows, csv_dim->cols);
+
     // Best params computed from running the hyperparameter search.
     size_t best_n_estimators = -1;
     double best_accuracy = -1;
@@ -55,7 +63,8 @@ void hyperparameter_search(double **data, struct dim *csv_dim)
                 .n_estimators = n_estimators,
                 .max_depth = max_depth,
                 .min_samples_leaf = min_samples_leaf,
-                .max_features = max_features
+                .max_features = max_features,
+                .n_classes = n_classes
             };
 
             log_if_level(0, "[hyperparameter search] testing params:\n  n_estimators: %ld\n  max_depth: %ld\n  min_samples_leaf: %ld\n  max_features: %ld\n",
@@ -106,23 +115,55 @@ double eval_model(const DecisionTreeNode **random_forest,
     // Since we are evaluating the model on a single fold (to control overfitting), we start
     // iterating the rows for which we are getting predictions at an offset that can be computed
     // as 'testingFoldIdx * rowsPerFold' and make predictions for 'rowsPerFold' number of rows
+    // Predictions for the whole fold are made as a single batch, so the votes of all processes are
+    // combined once per fold.
     size_t row_id_offset = ctx->testingFoldIdx * ctx->rowsPerFold;
-    for (size_t row_id = row_id_offset; row_id < row_id_offset + ctx->rowsPerFold; ++row_id)
+
+    if (params->regression)
     {
-        int prediction = predict_model(&random_forest,
+        double *values = malloc((ctx->rowsPerFold + 1) * sizeof(double));
+        predict_model_regression_batch(&random_forest,
                                        params->n_estimators,
-                                       data[row_id]);
-        int ground_truth = (int)data[row_id][csv_dim->cols - 1];
+                                       data + row_id_offset,
+                                       ctx->rowsPerFold,
+                                       values);
 
-        log_if_level(1, "majority vote:  %ld |  ground truth: %d\n",
-                prediction, ground_truth);
+        // Root mean squared error. Only rank 0 holds the predictions, the other ranks report 0.
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        double squared_error = 0.0;
+        if (rank == 0)
+        {
+            for (size_t i = 0; i < ctx->rowsPerFold; ++i)
+            {
+                double error = values[i] - data[row_id_offset + i][csv_dim->cols - 1];
+                squared_error += error * error;
+            }
+        }
+        free(values);
+        return rank == 0 ? sqrt(squared_error / (double)ctx->rowsPerFold) : 0.0;
+    }
 
-        // if (log_level > 1)
-        //     printf("majority vote: %d | %d ground truth\n", prediction, ground_truth);
+    int *predictions = malloc((ctx->rowsPerFold + 1) * sizeof(int));
+    predict_model_batch(&random_forest,
+                        params->n_estimators,
+                        params->n_classes,
+                        data + row_id_offset,
+                        ctx->rowsPerFold,
+                        predictions);
+
+    for (size_t i = 0; i < ctx->rowsPerFold; ++i)
+    {
+        int prediction = predictions[i];
+        int ground_truth = (int)data[row_id_offset + i][csv_dim->cols - 1];
+
+        log_if_level(1, "majority vote:  %d |  ground truth: %d\n",
+                prediction, ground_truth);
 
         if (prediction == ground_truth)
             ++num_correct;
     }
+    free(predictions);
     return (double)num_correct / (double)ctx->rowsPerFold;
 }
 
@@ -140,6 +181,14 @@ double cross_validate(double **data,
     size_t cols = csv_dim->cols;
     size_t rowsPerFold = rows / k_folds;
 
+    // All rows are sorted by every feature once. A fold's training rows are all rows but a
+    // contiguous testing block, so their order is filtered from this one. ExtraTrees never sorts.
+    Presort all_rows = {0};
+    int64_t presort_start = timer_now();
+    if (!params->extra_trees)
+        all_rows = presort_create(data, rows, cols);
+    timer_add(PHASE_PRESORT, presort_start);
+
     for (size_t foldIdx = 0; foldIdx < k_folds; ++foldIdx)
     {
         // Allocate training data (all rows except the test fold)
@@ -154,26 +203,176 @@ double cross_validate(double **data,
             }
         }
         struct dim train_dim = {train_rows, cols};
+
+        // Every tree of the fold trains on the same rows, so they share one sort order.
+        Presort presort = {0};
+        presort_start = timer_now();
+        if (!params->extra_trees)
+            presort = presort_without_rows(&all_rows, test_start, test_end);
+        timer_add(PHASE_PRESORT, presort_start);
+
         const ModelContext ctx = {
             .testingFoldIdx = foldIdx,
-            .rowsPerFold = rowsPerFold
+            .rowsPerFold = rowsPerFold,
+            .n_classes = params->n_classes,
+            .regression = params->regression,
+            .extra_trees = params->extra_trees,
+            .quantile_rows = params->quantile_rows,
+            .n_quantiles = params->n_quantiles,
+            .presort = params->extra_trees ? NULL : &presort
         };
         // Train on training data only
+        int64_t train_start = timer_now();
         const DecisionTreeNode **random_forest = train_model(
             train_data,
             params,
             &train_dim,
             &ctx);
+        timer_add(PHASE_TRAIN, train_start);
         // Evaluate on the test fold (still using the full data array for eval_model, which uses ctx to select test rows)
+        int64_t predict_start = timer_now();
+        PerfSample predict_sample;
+        perf_begin(&predict_sample);
         const double accuracy = eval_model(
             random_forest,
             data,
             params,
             csv_dim,
             &ctx);
+        perf_add(PERF_PREDICT, &predict_sample);
+        timer_add(PHASE_PREDICT, predict_start);
         sumAccuracy += accuracy;
         free_random_forest(&random_forest, params->n_estimators);
+        if (!params->extra_trees)
+            free_presort(&presort);
         free(train_data);
     }
+    if (!params->extra_trees)
+        free_presort(&all_rows);
+    report_cross_validation_work();
+    return sumAccuracy / k_folds;
+}
+
+/*
+Evaluates the testing fold of 'ctx' reading its rows from the workspace's source in batches that
+fit in the part of the budget reserved for histograms, which are not in use while predicting.
+A row sharded rank only predicts the testing rows of its own shard, with all trees, and the
+correct predictions of all ranks are summed at the end.
+*/
+static double eval_model_streaming(const DecisionTreeNode **random_forest,
+                                   HistWorkspace *ws,
+                                   const RandomForestParameters *params,
+                                   const ModelContext *ctx)
+{
+    const ColumnSource *src = ws->src;
+    size_t cols = src->dim.cols;
+    size_t batch_rows = ws->hist_bytes / (cols * sizeof(double));
+    if (batch_rows == 0)
+        batch_rows = 1;
+    if (batch_rows > ws->chunk_rows)
+        batch_rows = ws->chunk_rows;
+
+    double *batch = malloc(batch_rows * cols * sizeof(double));
+    double **row_ptrs = malloc(batch_rows * sizeof(double *));
+    int *predictions = malloc(batch_rows * sizeof(int));
+    long num_correct = 0;
+
+    // Testing rows of the fold, clamped to the rows visible through this rank's source.
+    size_t test_begin = ctx->testingFoldIdx * ctx->rowsPerFold;
+    size_t test_end = test_begin + ctx->rowsPerFold;
+    if (test_begin < src->row_offset)
+        test_begin = src->row_offset;
+    if (test_end > src->row_offset + src->dim.rows)
+        test_end = src->row_offset + src->dim.rows;
+
+    size_t row_id_offset = test_begin - src->row_offset;
+    size_t row_id_end = test_begin < test_end ? test_end - src->row_offset : row_id_offset;
+    for (size_t begin = row_id_offset; begin < row_id_end; begin += batch_rows)
+    {
+        size_t count = row_id_end - begin < batch_rows ? row_id_end - begin : batch_rows;
+
+        // Transpose the columns of the batch into rows for 'predict_model'.
+        for (size_t j = 0; j < cols; ++j)
+        {
+            src->read_column(src, j, begin, count, ws->buffer);
+            for (size_t i = 0; i < count; ++i)
+                batch[i * cols + j] = ws->buffer[i];
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            row_ptrs[i] = batch + i * cols;
+
+        // Sharded ranks hold every tree and vote alone; otherwise the votes of the batch are
+        // combined over all ranks at once.
+        if (ws->row_sharded)
+        {
+            for (size_t i = 0; i < count; ++i)
+                predictions[i] = predict_model_replicated(random_forest, params->n_estimators, ws->n_classes, row_ptrs[i]);
+        }
+        else
+            predict_model_batch(&random_forest, params->n_estimators, ws->n_classes, row_ptrs, count, predictions);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            int ground_truth = (int)row_ptrs[i][cols - 1];
+
+            log_if_level(1, "majority vote:  %d |  ground truth: %d\n", predictions[i], ground_truth);
+
+            if (predictions[i] == ground_truth)
+                ++num_correct;
+        }
+    }
+
+    free(batch);
+    free(row_ptrs);
+    free(predictions);
+
+    if (ws->row_sharded)
+    {
+        int64_t reduce_start = timer_now();
+        MPI_Allreduce(MPI_IN_PLACE, &num_correct, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+        timer_add(PHASE_REDUCE, reduce_start);
+    }
+
+    return (double)num_correct / (double)ctx->rowsPerFold;
+}
+
+double cross_validate_streaming(const ColumnSource *src,
+                                const FeatureBins *bins,
+                                const RandomForestParameters *params,
+                                const size_t k_folds,
+                                const size_t mem_budget,
+                                const int row_sharded)
+{
+    HistWorkspace ws = hist_workspace_create(src, bins, mem_budget, row_sharded);
+
+    double sumAccuracy = 0;
+    size_t rowsPerFold = src->total_rows / k_folds;
+
+    for (size_t foldIdx = 0; foldIdx < k_folds; ++foldIdx)
+    {
+        const ModelContext ctx = {
+            .testingFoldIdx = foldIdx,
+            .rowsPerFold = rowsPerFold,
+            .n_classes = ws.n_classes
+        };
+        int64_t train_start = timer_now();
+        const DecisionTreeNode **random_forest = train_model_hist(&ws, params, &ctx);
+        timer_add(PHASE_TRAIN, train_start);
+
+        int64_t predict_start = timer_now();
+        PerfSample predict_sample;
+        perf_begin(&predict_sample);
+        sumAccuracy += eval_model_streaming(random_forest, &ws, params, &ctx);
+        perf_add(PERF_PREDICT, &predict_sample);
+        timer_add(PHASE_PREDICT, predict_start);
+        if (row_sharded)
+            free_replicated_random_forest(&random_forest, params->n_estimators);
+        else
+            free_random_forest(&random_forest, params->n_estimators);
+    }
+
+    free_hist_workspace(&ws);
+    report_cross_validation_work();
     return sumAccuracy / k_folds;
 }
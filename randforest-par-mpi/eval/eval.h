@@ -13,6 +13,7 @@
 
 #include "../model/tree.h"
 #include "../model/forest.h"
+#include "../model/hist.h"
 #include "../utils/utils.h"
 #include "../utils/data.h"
 
@@ -25,7 +26,8 @@ void hyperparameter_search(double **data, struct dim *csv_dim);
 
 /*
 Runs k-fold cross validation on the 'data' and returns the accuracy. In the process builds up a random
-forest model for each iteration and evaluates on a separate test fold.
+forest model for each iteration and evaluates on a separate test fold. Regression forests return the
+mean root mean squared error of the folds instead, which is only computed on rank 0.
 */
 double cross_validate(double **data,
                       const RandomForestParameters *params,
@@ -35,4 +37,19 @@ double cross_validate(double **data,
                       //rufino@ipb.pt: to avoid the following warning in a loop
                       //warning: comparison of integer expressions of different signedness: ‘size_t’ {aka ‘long unsigned int’} and ‘int’ 
 
+/*
+Runs k-fold cross validation like 'cross_validate', but trains every fold with the streaming
+histogram trainer reading straight from 'src', so that no process holds more than 'mem_budget'
+bytes of the dataset at a time. 'bins' must be identical on all ranks.
+
+With 'row_sharded' set, 'src' only holds this rank's shard of the rows: all ranks then train every
+tree together, reducing the histograms of each level, and evaluate their own testing rows.
+*/
+double cross_validate_streaming(const ColumnSource *src,
+                                const FeatureBins *bins,
+                                const RandomForestParameters *params,
+                                const size_t k_folds,
+                                const size_t mem_budget,
+                                const int row_sharded);
+
 #endif // eval_h
@@ -15,19 +15,217 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <mpi.h>
 #include "eval/eval.h"
 #include "utils/argparse.h"
 #include "utils/data.h"
 #include "utils/utils.h"
 #include "utils/log.h"
+#include "utils/colstore.h"
+#include "utils/timer.h"
+#include "utils/perf.h"
+#include "model/partition.h"
 
 
+/*
+Returns the '--mem_budget' in bytes, or 0 (after reporting it on rank 0) if it is not valid.
+*/
+static size_t mem_budget_bytes(const struct arguments *arguments, int rank)
+{
+    if (arguments->mem_budget <= 0) {
+        if (rank == 0)
+            printf("Error: --mem_budget must be a positive number of MB, got: %ld\n", arguments->mem_budget);
+        return 0;
+    }
+    return (size_t)arguments->mem_budget * 1024 * 1024;
+}
+
+/*
+Prints the result of a cross validation run on rank 0.
+*/
+static void report_cv_accuracy(int rank, double cv_accuracy, double seconds)
+{
+    if (rank == 0) {
+      printf("cross validation accuracy: %f%% (%ld%%)\n",
+           (cv_accuracy * 100),
+           (long)(cv_accuracy * 100));
+      printf("(time taken: %fs)\n", seconds);
+    }
+}
+
+/*
+Runs cross validation streaming the dataset from the column store given by '--colstore'. If a csv
+file was also given and the store does not exist yet, rank 0 converts the csv into the store first.
+With '--row_shard' every rank only streams its own shard of the rows.
+*/
+static int train_out_of_core(const struct arguments *arguments,
+                             unsigned int seed,
+                             const RandomForestParameters *params,
+                             int k_folds)
+{
+    int rank, numtasks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    size_t mem_budget = mem_budget_bytes(arguments, rank);
+    if (mem_budget == 0)
+        return 1;
+
+    if (rank == 0 && arguments->args[0]) {
+        FILE *existing = fopen(arguments->colstore, "rb");
+        if (existing)
+            fclose(existing);
+        else {
+            int64_t parse_start = timer_now();
+            PerfSample load_sample;
+            perf_begin(&load_sample);
+            csv_to_colstore(arguments->args[0], arguments->colstore, mem_budget);
+            perf_add(PERF_LOAD, &load_sample);
+            timer_add(PHASE_PARSE, parse_start);
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    ColumnStore store = colstore_open(arguments->colstore);
+    ColumnSource full = column_source_from_store(&store);
+    ColumnSource src = arguments->row_shard ? column_source_shard(&full, rank, numtasks) : full;
+
+    if (rank == 0) {
+      log_if_level(0, "using:\n  seed: %d\n  verbose log level: %d\n  rows: %ld, cols: %ld\n"
+                      "streaming from column store:\n  \"%s\"\n  mem_budget: %ld MB\n  n_bins: %ld\n"
+                      "  k_folds: %d\n  row sharded: %d\n",
+                   seed,
+                   arguments->log_level,
+                   store.dim.rows,
+                   store.dim.cols,
+                   arguments->colstore,
+                   arguments->mem_budget,
+                   params->n_bins,
+                   k_folds,
+                   arguments->row_shard);
+      if (log_level > 0)
+        print_params(params);
+    }
+
+    int64_t cv_start = timer_now();
+    int64_t bins_start = timer_now();
+    FeatureBins bins = broadcast_feature_bins(&full, params->n_bins);
+    timer_add(PHASE_BROADCAST, bins_start);
+    double cv_accuracy = cross_validate_streaming(&src, &bins, params, k_folds, mem_budget, arguments->row_shard);
+    timer_add(PHASE_CROSS_VALIDATE, cv_start);
+
+    report_cv_accuracy(rank, cv_accuracy, timer_seconds(PHASE_CROSS_VALIDATE));
+    timer_report(arguments->timings);
+    if (arguments->trace)
+        trace_write(arguments->trace);
+
+    free_feature_bins(&bins);
+    colstore_close(&store);
+    return 0;
+}
+
+/*
+Runs row sharded cross validation on the csv file. Rank 0 converts the csv into a temporary column
+store next to it, reading it one line at a time within '--mem_budget', and every rank then loads
+only its own shard of the rows from the store, so no process ever holds more than 1/N of the
+dataset. All ranks then build every tree together, combining their class histograms once per tree
+level.
+*/
+static int train_row_sharded(const struct arguments *arguments,
+                             unsigned int seed,
+                             const RandomForestParameters *params,
+                             int k_folds)
+{
+    int rank, numtasks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    size_t mem_budget = mem_budget_bytes(arguments, rank);
+    if (mem_budget == 0)
+        return 1;
+
+    // The store is named after rank 0's process, so concurrent runs on the same csv don't collide.
+    long store_id = rank == 0 ? (long)getpid() : 0;
+    MPI_Bcast(&store_id, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+    char *store_file = malloc(strlen(arguments->args[0]) + 32);
+    sprintf(store_file, "%s.shard%ld.col", arguments->args[0], store_id);
+
+    if (rank == 0) {
+        int64_t parse_start = timer_now();
+        PerfSample load_sample;
+        perf_begin(&load_sample);
+        csv_to_colstore(arguments->args[0], store_file, mem_budget);
+        perf_add(PERF_LOAD, &load_sample);
+        timer_add(PHASE_PARSE, parse_start);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    ColumnStore store = colstore_open(store_file);
+    ColumnSource full = column_source_from_store(&store);
+
+    // '--num_rows' keeps only the first rows, as 'parse_csv' does.
+    if (arguments->rows && (size_t)arguments->rows < full.dim.rows) {
+        full.dim.rows = arguments->rows;
+        full.total_rows = arguments->rows;
+    }
+
+    if (rank == 0) {
+      log_if_level(0, "using:\n  seed: %d\n  verbose log level: %d\n  rows: %ld, cols: %ld\n"
+                      "reading from csv file:\n  \"%s\"\n  row sharded over %d processes\n"
+                      "  mem_budget: %ld MB\n  n_bins: %ld\n  k_folds: %d\n",
+                   seed,
+                   arguments->log_level,
+                   full.dim.rows,
+                   full.dim.cols,
+                   arguments->args[0],
+                   numtasks,
+                   arguments->mem_budget,
+                   params->n_bins,
+                   k_folds);
+      if (log_level > 0)
+        print_params(params);
+    }
+
+    int64_t load_start = timer_now();
+    ColumnSource shard_view = column_source_shard(&full, rank, numtasks);
+    double *shard = column_source_load_rows(&shard_view);
+    timer_add(PHASE_BROADCAST, load_start);
+
+    ColumnSource src = column_source_from_rows(shard, shard_view.dim, shard_view.row_offset, full.dim.rows);
+
+    int64_t cv_start = timer_now();
+
+    // Rank 0 computes the bins from a sample of all rows of the store.
+    int64_t bins_start = timer_now();
+    FeatureBins bins = broadcast_feature_bins(&full, params->n_bins);
+    timer_add(PHASE_BROADCAST, bins_start);
+
+    colstore_close(&store);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0)
+        remove(store_file);
+    free(store_file);
+
+    double cv_accuracy = cross_validate_streaming(&src, &bins, params, k_folds, mem_budget, 1);
+    timer_add(PHASE_CROSS_VALIDATE, cv_start);
+
+    report_cv_accuracy(rank, cv_accuracy, timer_seconds(PHASE_CROSS_VALIDATE));
+    timer_report(arguments->timings);
+    if (arguments->trace)
+        trace_write(arguments->trace);
+
+    free_feature_bins(&bins);
+    free(shard);
+    return 0;
+}
 
 
 int main(int argc, char **argv)
 {
-    MPI_Init(&argc, &argv);
+    // Only the main thread makes MPI calls, worker threads just build trees.
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     int rank, numtasks;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
@@ -35,11 +233,21 @@ int main(int argc, char **argv)
     struct arguments arguments;
     unsigned int seed;
     
-    // rank 0 faz parse e setup inicial
+    // todos os processos fazem parse dos mesmos argumentos, assim as opcoes
+    // (log_level, modo de treino, ...) ficam disponiveis sem broadcast
+    parse_args(argc, argv, &arguments);
+    set_log_level(arguments.log_level);
+    if (arguments.log_file)
+        log_open_rank_file(arguments.log_file, rank);
+    if (arguments.trace)
+        trace_enable();
+    if (arguments.perf_counters)
+        perf_enable(rank);
+    if (rank == 0 && arguments.log_level > LOG_MAX_LEVEL)
+        printf("Warning: built with LOG_MAX_LEVEL=%d, --log_level %d prints the same as --log_level %d\n",
+               LOG_MAX_LEVEL, arguments.log_level, LOG_MAX_LEVEL);
+
     if (rank == 0) {
-        parse_args(argc, argv, &arguments);
-        set_log_level(arguments.log_level);
-        
         if (arguments.random_seed != RAND_MAX) 
             seed = arguments.random_seed;
         else 
@@ -48,30 +256,140 @@ int main(int argc, char **argv)
     
     // broadcast da seed para garantir mesmos numeros aleatorios
     MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-    srand(seed);
-
-    // broadcast log_level para workers conseguirem logar
-    int log_level_val;
-    if (rank == 0) {
-        log_level_val = arguments.log_level;
-    }
-    
-    MPI_Bcast(&log_level_val, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if (rank != 0) {
-        set_log_level(log_level_val);
-    }
 
     // Read the csv file from args which must be parsed now.
-    const char *file_name = NULL;
+    const char *file_name = arguments.args[0];
     
     if (rank == 0) {
-        file_name = arguments.args[0];
-        if (!file_name) {
-            printf("Usage: %s <CSV_FILE> [--num_rows N] [--num_cols N] [--log_level N] [--seed N]\n", argv[0]);
+        if (!file_name && !arguments.colstore) {
+            printf("Usage: %s <CSV_FILE> [--num_rows N] [--num_cols N] [--log_level N] [--seed N]"
+                   " [--colstore FILE] [--mem_budget MB] [--n_bins N] [--row_shard] [--feature_ranks N] [--threads N]\n"
+                   " [--subtree_cutoff ROWS] [--regression] [--extra_trees] [--quantile_rows ROWS] [--n_quantiles N]\n"
+                   " [--level_wise] [--max_leaves N] [--split_budget N] [--log_file PREFIX] [--timings FILE]\n"
+                   " [--trace FILE] [--perf_counters] [--n_estimators N] [--max_depth N] [--min_samples_leaf N]\n"
+                   " [--max_features N] [--k_folds N]\n", argv[0]);
             MPI_Abort(MPI_COMM_WORLD, 1);
         }
     }
 
+    //rufino@ipb.pt: keep note of the default values
+    //const int k_folds = 5 ;
+    //const int k_folds = 20 ;
+    const int k_folds = arguments.k_folds;
+
+    // Example configuration for a random forest model.
+        //rufino@ipb.pt: keep note of the default values
+        //.n_estimators = 3 /* Number of trees in the random forest model. */,
+        //.max_depth = 7 /* Maximum depth of a tree in the model. */,
+        //.min_samples_leaf = 3,
+        //.max_features = 3
+    // The defaults of '--n_estimators', '--max_depth', '--min_samples_leaf', '--max_features' and
+    // '--k_folds' are 20, 7, 3, 20 and 20.
+    RandomForestParameters params = {
+        .n_estimators = (size_t)arguments.n_estimators /* Number of trees in the random forest model. */,
+        .max_depth = (size_t)arguments.max_depth /* Maximum depth of a tree in the model. */,
+        .min_samples_leaf = (size_t)arguments.min_samples_leaf,
+        .max_features = (size_t)arguments.max_features,
+        .n_bins = arguments.n_bins,
+        .seed = seed,
+        .regression = arguments.regression,
+        .extra_trees = arguments.extra_trees,
+        .quantile_rows = (size_t)arguments.quantile_rows,
+        .n_quantiles = (size_t)arguments.n_quantiles,
+        .level_wise = arguments.level_wise,
+        .max_leaves = (size_t)arguments.max_leaves,
+        .split_budget = (size_t)arguments.split_budget
+    };
+
+    if (arguments.n_estimators < 1 || arguments.max_depth < 1 || arguments.min_samples_leaf < 0 ||
+        arguments.max_features < 1 || k_folds < 2) {
+        if (rank == 0)
+            printf("Error: --n_estimators, --max_depth and --max_features must be >= 1, --min_samples_leaf >= 0 and --k_folds >= 2\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (arguments.quantile_rows < 0 || arguments.n_quantiles < 2) {
+        if (rank == 0)
+            printf("Error: --quantile_rows must be >= 0 and --n_quantiles >= 2, got: %ld and %ld\n",
+                   arguments.quantile_rows, arguments.n_quantiles);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Bin edges are quantiles of at most BIN_SAMPLE_ROWS sampled values per feature, so more bins
+    // than that can't be told apart.
+    if (arguments.n_bins < 2 || arguments.n_bins > BIN_SAMPLE_ROWS) {
+        if (rank == 0)
+            printf("Error: --n_bins must be in range [2, %d], got: %d\n", BIN_SAMPLE_ROWS, arguments.n_bins);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // The level-wise builder sweeps the presorted features, which ExtraTrees doesn't use.
+    if (params.level_wise && params.extra_trees) {
+        if (rank == 0)
+            printf("Error: --level_wise can't be combined with --extra_trees\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (arguments.max_leaves < 0 || arguments.max_leaves == 1 || arguments.split_budget < 0 ||
+        (params.level_wise && (params.max_leaves > 0 || params.split_budget > 0))) {
+        if (rank == 0)
+            printf("Error: --max_leaves must be 0 or >= 2 and --split_budget >= 0, and neither can be combined with --level_wise\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Regression and ExtraTrees are only implemented by the exact, in-memory trainer.
+    if ((params.regression || params.extra_trees) && (arguments.colstore || arguments.row_shard)) {
+        if (rank == 0)
+            printf("Error: --regression and --extra_trees can't be combined with --colstore or --row_shard\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Out-of-core training never loads the dataset: it streams it from a column store, which
+    // rank 0 first creates from the csv file if it was given one.
+    if (arguments.colstore) {
+        int status = train_out_of_core(&arguments, seed, &params, k_folds);
+        MPI_Finalize();
+        return status;
+    }
+
+    // Feature parallel split search: groups of ranks build each tree together.
+    if (arguments.feature_ranks < 1 || arguments.feature_ranks > numtasks) {
+        if (rank == 0)
+            printf("Error: --feature_ranks must be in range [1, %d] got: %d\n", numtasks, arguments.feature_ranks);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (arguments.feature_ranks > 1) {
+        set_feature_parallel_ranks(arguments.feature_ranks);
+        if (rank == 0)
+            log_if_level(0, "using:\n  feature parallel ranks per tree: %d\n", arguments.feature_ranks);
+    }
+
+    // Hybrid mode: worker threads of each rank build its trees, sharing one copy of the data.
+    if (arguments.threads < 1 || (arguments.threads > 1 && arguments.feature_ranks > 1)) {
+        if (rank == 0)
+            printf("Error: --threads must be >= 1 and can't be combined with --feature_ranks, got: %d\n", arguments.threads);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (arguments.subtree_cutoff < 0) {
+        if (rank == 0)
+            printf("Error: --subtree_cutoff must be >= 0, got: %ld\n", arguments.subtree_cutoff);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (arguments.threads > 1) {
+        if (provided < MPI_THREAD_FUNNELED && rank == 0)
+            printf("Warning: MPI library does not provide MPI_THREAD_FUNNELED\n");
+        set_tree_threads(arguments.threads, (size_t)arguments.subtree_cutoff);
+        if (rank == 0)
+            log_if_level(0, "using:\n  worker threads per process: %d\n  subtree task cutoff: %ld rows\n",
+                         arguments.threads, arguments.subtree_cutoff);
+    }
+
+    // Row sharded training splits the rows, not the trees, across the ranks.
+    if (arguments.row_shard) {
+        int status = train_row_sharded(&arguments, seed, &params, k_folds);
+        MPI_Finalize();
+        return status;
+    }
+
     // If the values for rows and cols were provided as arguments, then use them for the
     // 'dim' struct, otherwise call 'parse_csv_dims()' to parse the csv file provided to
     // compute the size of the csv file.
@@ -87,25 +405,40 @@ int main(int argc, char **argv)
 
       //rufino@ipv.pt: removed indentation to avoid "warning: this ‘else’ clause does not guard"
       //rufino@ipv.pt: added seed used
-      log_if_level(0, "using:\n  seed: %d\n  verbose log level: %d\n  rows: %ld, cols: %ld\nreading from csv file:\n  \"%s\"\n",
+      log_if_level(0, "using:\n  seed: %d\n  verbose log level: %d\n  rows: %ld, cols: %ld\n  partition kernel: %s\nreading from csv file:\n  \"%s\"\n",
                seed,
                arguments.log_level,
                csv_dim.rows,
                csv_dim.cols,
+               partition_kernel_name(),
                file_name);
 
 
       // Allocate memory for the data coming from the .csv and read in the data.
+      int64_t parse_start = timer_now();
+      PerfSample load_sample;
+      perf_begin(&load_sample);
       data = malloc(sizeof(double) * csv_dim.rows * csv_dim.cols);
       parse_csv(file_name, &data, csv_dim);
+      perf_add(PERF_LOAD, &load_sample);
+      timer_add(PHASE_PARSE, parse_start);
 
       // Compute a checksum of the data to verify that loaded correctly.
       log_if_level(1, "data checksum = %f\n", _1d_checksum(data, csv_dim.rows * csv_dim.cols));
     }
     
     // broadcast dimensoes
+    int64_t broadcast_start = timer_now();
     MPI_Bcast(&csv_dim.rows, 1, MPI_LONG, 0, MPI_COMM_WORLD);
     MPI_Bcast(&csv_dim.cols, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    // Every split samples 'max_features' distinct features out of all columns but the target.
+    if (params.max_features > (size_t)csv_dim.cols - 1 || (size_t)csv_dim.rows < (size_t)k_folds) {
+        if (rank == 0)
+            printf("Error: --max_features must be at most %ld (the columns but the target) and --k_folds at most %ld (the rows), got: %zu and %d\n",
+                   csv_dim.cols - 1, csv_dim.rows, params.max_features, k_folds);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     
     // workers alocam espaco
     if (rank != 0) {
@@ -115,62 +448,60 @@ int main(int argc, char **argv)
     // broadcast dados
     int n_elements = (int)(csv_dim.rows * csv_dim.cols);
     MPI_Bcast(data, n_elements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    timer_add(PHASE_BROADCAST, broadcast_start);
 
-    //rufino@ipb.pt: keep note of the default values
-    //const int k_folds = 5 ;
-    const int k_folds = 20 ;
+    // Pivot the csv file data into a two dimensional array.
+    int64_t pivot_start = timer_now();
+    double **pivoted_data;
+    pivot_data(data, csv_dim, &pivoted_data);
+    timer_add(PHASE_PIVOT, pivot_start);
+
+    // Every rank holds all rows, so each finds the same classes without communicating.
+    if (!params.regression)
+        params.n_classes = count_classes(pivoted_data, csv_dim.rows, csv_dim.cols);
 
     if (rank == 0) {
-      log_if_level(0, "using:\n  k_folds: %d\n", k_folds);
+      if (params.regression)
+        log_if_level(0, "using:\n  k_folds: %d\n  regression\n", k_folds);
+      else
+        log_if_level(0, "using:\n  k_folds: %d\n  classes: %zu\n", k_folds, params.n_classes);
     }
-
-    // Example configuration for a random forest model.
-        //rufino@ipb.pt: keep note of the default values
-        //.n_estimators = 3 /* Number of trees in the random forest model. */,
-        //.max_depth = 7 /* Maximum depth of a tree in the model. */,
-        //.min_samples_leaf = 3,
-        //.max_features = 3
-    const RandomForestParameters params = {
-        .n_estimators = 20 /* Number of trees in the random forest model. */,
-        .max_depth = 7 /* Maximum depth of a tree in the model. */,
-        .min_samples_leaf = 3,
-        .max_features = 20
-    };
+    if (rank == 0 && params.extra_trees)
+        log_if_level(0, "using:\n  extremely randomized trees\n");
 
     // Print random forest parameters.
     if (rank == 0 && log_level > 0) {
         print_params(&params);
     }
 
-    // Pivot the csv file data into a two dimensional array.
-    double **pivoted_data;
-    pivot_data(data, csv_dim, &pivoted_data);
-
     if (rank == 0) {
       log_if_level(1, "checksum of pivoted 2d array: %f\n", _2d_checksum(pivoted_data, csv_dim.rows, csv_dim.cols));
     }
     
-    // Start the clock for timing.
+    // Start the clock for timing: wall-clock time on every rank, waiting in collectives included.
     double cv_accuracy;
-    clock_t begin_clock, end_clock;
-    
-    if (rank == 0) {
-      begin_clock = clock();
-    }
+    int64_t cv_start = timer_now();
     
     cv_accuracy = cross_validate(pivoted_data, &params, &csv_dim, k_folds);
+    timer_add(PHASE_CROSS_VALIDATE, cv_start);
     
     if (rank == 0) {
-      end_clock = clock();
-      printf("cross validation accuracy: %f%% (%ld%%)\n",
-           (cv_accuracy * 100),
-           (long)(cv_accuracy * 100));
-      printf("(time taken: %fs)\n", (double)(end_clock - begin_clock) / CLOCKS_PER_SEC);
+      if (params.regression)
+        printf("cross validation RMSE: %f\n", cv_accuracy);
+      else
+        printf("cross validation accuracy: %f%% (%ld%%)\n",
+             (cv_accuracy * 100),
+             (long)(cv_accuracy * 100));
+      printf("(time taken: %fs)\n", timer_seconds(PHASE_CROSS_VALIDATE));
     }
+    timer_report(arguments.timings);
+    if (arguments.trace)
+        trace_write(arguments.trace);
 
     // Free loaded csv file data.
     free(data);
     free(pivoted_data);
+    set_tree_threads(1, 0);
     MPI_Finalize();
     return 0;
 }
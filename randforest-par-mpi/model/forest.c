@@ -3,20 +3,279 @@
 */
 
 #include "forest.h"
+#include "hist.h"
+#include "presort.h"
+#include "../utils/threadpool.h"
+#include "../utils/timer.h"
 #include <mpi.h>
+#include <sys/resource.h>
+
+/*
+Ranks building the same trees together (see 'set_feature_parallel_ranks'). The trees are divided
+among these groups rather than among single ranks.
+*/
+static MPI_Comm tree_comm = MPI_COMM_NULL;
+static int tree_group_size = 1;
+
+void set_feature_parallel_ranks(int ranks)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (tree_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&tree_comm);
+
+    // Groups of 'ranks' consecutive ranks; the last group is smaller if they don't divide evenly.
+    tree_group_size = ranks;
+    MPI_Comm_split(MPI_COMM_WORLD, rank / ranks, rank, &tree_comm);
+    set_split_comm(tree_comm);
+}
+
+/*
+Returns this rank's group index and the number of groups the trees are divided among.
+*/
+static void tree_group(int *group, int *n_groups)
+{
+    int rank, numtasks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
+
+    *group = rank / tree_group_size;
+    *n_groups = (numtasks + tree_group_size - 1) / tree_group_size;
+}
+
+/*
+Returns 1 if this rank casts the votes of its trees, i.e. it is the first rank of its group.
+Other ranks of a group hold copies of the same trees and must not count them again.
+*/
+static int casts_votes()
+{
+    int group_rank = 0;
+    if (tree_comm != MPI_COMM_NULL)
+        MPI_Comm_rank(tree_comm, &group_rank);
+    return group_rank == 0;
+}
+
+/*
+Computes the range [start_tree, end_tree) of global tree ids built and owned by this process.
+*/
+static void local_tree_range(size_t n_estimators, int *start_tree, int *end_tree)
+{
+    int rank, numtasks;
+    tree_group(&rank, &numtasks);
+
+    // calcula quantas arvores cada processo vai construir
+    int trees_per_process = n_estimators / numtasks;
+    int remainder = n_estimators % numtasks;
+
+    // ind de incio e fim para este processo
+    *start_tree = rank * trees_per_process + (rank < remainder ? rank : remainder);
+    *end_tree = *start_tree + trees_per_process + (rank < remainder ? 1 : 0);
+}
+
+/*
+Worker threads building this rank's trees concurrently (see 'set_tree_threads').
+*/
+static ThreadPool *tree_pool = NULL;
+
+void set_tree_threads(int n_threads, size_t subtree_cutoff)
+{
+    set_subtree_pool(NULL, 0);
+    if (tree_pool)
+        thread_pool_destroy(tree_pool);
+    tree_pool = n_threads > 1 ? thread_pool_create(n_threads) : NULL;
+    if (tree_pool && subtree_cutoff > 0)
+        set_subtree_pool(tree_pool, subtree_cutoff);
+}
+
+/*
+Work of the trees built by this rank, summed over the trees of the current fold and over the whole
+cross validation. The extremes of single trees show how unevenly the work is spread over them.
+*/
+typedef struct WorkTotals
+{
+    TreeStats sum; // 'max_depth' is the depth of the deepest tree.
+    long trees;
+    double seconds_min;
+    double seconds_max;
+    long scanned_min;
+    long scanned_max;
+} WorkTotals;
+
+static WorkTotals fold_work = {.seconds_min = DBL_MAX, .scanned_min = LONG_MAX};
+static WorkTotals cv_work = {.seconds_min = DBL_MAX, .scanned_min = LONG_MAX};
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void merge_work(WorkTotals *totals, const WorkTotals *more)
+{
+    tree_stats_add(&totals->sum, &more->sum);
+    totals->trees += more->trees;
+    totals->seconds_min = more->seconds_min < totals->seconds_min ? more->seconds_min : totals->seconds_min;
+    totals->seconds_max = more->seconds_max > totals->seconds_max ? more->seconds_max : totals->seconds_max;
+    totals->scanned_min = more->scanned_min < totals->scanned_min ? more->scanned_min : totals->scanned_min;
+    totals->scanned_max = more->scanned_max > totals->scanned_max ? more->scanned_max : totals->scanned_max;
+}
+
+/*
+Measures the tree of 'arena' rooted at 'root', which took 'seconds' to build, and adds it to the
+work of the fold. Called by the threads building trees.
+*/
+static void record_tree_work(int tree_id, const DecisionTreeNode *root, NodeArena *arena, double seconds)
+{
+    TreeStats *stats = &arena->stats;
+    measure_tree(root, stats);
+
+    log_if_level(1, "tree %d: %.6f s, %ld nodes, %ld leaves, depth %ld, %ld candidates, %ld rows scanned, "
+                    "%ld rows partitioned, %ld bytes\n",
+                 tree_id, seconds, stats->nodes, stats->leaves, stats->max_depth, stats->candidates,
+                 stats->rows_scanned, stats->rows_partitioned, stats->bytes);
+
+    WorkTotals tree = {*stats, 1, seconds, seconds, stats->rows_scanned, stats->rows_scanned};
+    pthread_mutex_lock(&work_lock);
+    merge_work(&fold_work, &tree);
+    pthread_mutex_unlock(&work_lock);
+}
+
+/*
+Sums 'totals' over all ranks on rank 0, which prints them as the work of 'what' along with the
+largest peak resident memory of any rank. Only when 'log_level' is above 1, so default runs neither
+print nor reduce anything more, and as every rank sees the same level. Collective.
+*/
+static void report_work(const WorkTotals *totals, const char *what)
+{
+    if (log_level <= 1)
+        return;
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const TreeStats *sum = &totals->sum;
+    long sums[7] = {totals->trees, sum->nodes, sum->leaves, sum->candidates, sum->rows_scanned,
+                    sum->rows_partitioned, sum->bytes};
+    // Minimums are reduced as the maximum of their negation.
+    double maxes[6] = {(double)sum->max_depth, totals->seconds_max, -totals->seconds_min,
+                       (double)totals->scanned_max, -(double)totals->scanned_min,
+                       (double)usage.ru_maxrss * 1024.0 /* kilobytes on Linux */};
+
+    long all_sums[7];
+    double all_maxes[6];
+    int64_t reduce_start = timer_now();
+    MPI_Reduce(sums, all_sums, 7, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(maxes, all_maxes, 6, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    timer_add(PHASE_REDUCE, reduce_start);
+
+    if (rank != 0 || all_sums[0] == 0)
+        return;
+
+    printf("work of %s over %d ranks: %ld trees, %ld nodes, %ld leaves, depth <= %.0f, %ld candidates, "
+           "%ld rows scanned, %ld rows partitioned, %.1f MB allocated, peak RSS %.1f MB\n",
+           what, size, all_sums[0], all_sums[1], all_sums[2], all_maxes[0], all_sums[3], all_sums[4],
+           all_sums[5], (double)all_sums[6] / 1e6, all_maxes[5] / 1e6);
+    printf("  per tree: %.6f - %.6f s, %.0f - %.0f rows scanned\n",
+           -all_maxes[2], all_maxes[1], -all_maxes[4], all_maxes[3]);
+}
+
+/*
+Reports the work of the trees of the fold that was just trained and moves it to the work of the
+cross validation. Collective.
+*/
+static void finish_fold_work(size_t fold)
+{
+    char what[32];
+    snprintf(what, sizeof(what), "fold %zu", fold);
+    report_work(&fold_work, what);
+
+    merge_work(&cv_work, &fold_work);
+    fold_work = (WorkTotals){.seconds_min = DBL_MAX, .scanned_min = LONG_MAX};
+}
+
+void report_cross_validation_work(void)
+{
+    report_work(&cv_work, "cross validation");
+    cv_work = (WorkTotals){.seconds_min = DBL_MAX, .scanned_min = LONG_MAX};
+}
+
+/*
+A single tree to build: the inputs shared by all trees of the fold, the tree's own generator and
+where to store its root.
+*/
+typedef struct TreeTask
+{
+    double **data;
+    const RandomForestParameters *params;
+    const struct dim *csv_dim;
+    const ModelContext *ctx;
+    int tree_id;
+    RandomState rng;
+    const DecisionTreeNode **root;
+} TreeTask;
+
+static void build_tree_task(void *arg)
+{
+    TreeTask *task = arg;
+
+    // The nodes of the tree are allocated from one arena, which also gives every node a strictly
+    // increasing ID for debugging.
+    NodeArena arena;
+    node_arena_init(&arena);
+
+    log_if_level(2, "building global tree %d\n", task->tree_id);
+
+    int64_t tree_start = timer_now();
+    *task->root = train_model_tree(task->data, task->params, task->csv_dim, &arena, task->ctx, &task->rng);
+    timer_add(PHASE_TREE, tree_start);
+    record_tree_work(task->tree_id, *task->root, &arena, (double)(timer_now() - tree_start) / 1e9);
+    node_arena_finish(&arena);
+}
 
 const DecisionTreeNode *train_model_tree(double **data,
                                          const RandomForestParameters *params,
                                          const struct dim *csv_dim,
-                                         long *nodeId /* Ascending node ID generator */,
-                                         const ModelContext *ctx)
+                                         NodeArena *arena /* Allocator and ID generator of the tree's nodes */,
+                                         const ModelContext *ctx,
+                                         RandomState *rng)
 {
-    DecisionTreeNode *root = empty_node(nodeId);
+    if (params->max_leaves > 0 || params->split_budget > 0)
+        return grow_best_first(data,
+                               ctx->presort ? ctx->presort->order : NULL,
+                               csv_dim->rows,
+                               csv_dim->cols,
+                               params->max_depth,
+                               params->min_samples_leaf,
+                               params->max_features,
+                               params->max_leaves,
+                               params->split_budget,
+                               arena,
+                               ctx,
+                               rng);
+
+    if (params->level_wise && ctx->presort)
+        return grow_level_wise(data,
+                               ctx->presort->order,
+                               csv_dim->rows,
+                               csv_dim->cols,
+                               params->max_depth,
+                               params->min_samples_leaf,
+                               params->max_features,
+                               arena,
+                               ctx,
+                               rng);
+
+    reserve_split_scratch(params->max_features, csv_dim->rows, ctx->n_classes);
+
+    DecisionTreeNode *root = empty_node(arena);
     DecisionTreeDataSplit data_split = calculate_best_data_split(data,
+                                                                 ctx->presort ? ctx->presort->order : NULL,
                                                                  params->max_features,
                                                                  csv_dim->rows,
                                                                  csv_dim->cols,
-                                                                 ctx);
+                                                                 ctx,
+                                                                 &arena->stats,
+                                                                 rng);
     
                                                                  
     log_if_level(1, "calculated best split for the dataset in train_model_tree\n"
@@ -38,8 +297,9 @@ const DecisionTreeNode *train_model_tree(double **data,
          1 /* Current depth. */,
          csv_dim->rows,
          csv_dim->cols,
-         nodeId,
-         ctx);
+         arena,
+         ctx,
+         rng);
 
     // Free any temp memory.
     free(data_split.data);
@@ -52,19 +312,11 @@ const DecisionTreeNode **train_model(double **data,
                                      const struct dim *csv_dim,
                                      const ModelContext *ctx)
 {
-    int rank, numtasks;
+    int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
-    
-    int n_trees = params->n_estimators;
-    
-    // calcula quantas arvores cada processo vai construir
-    int trees_per_process = n_trees / numtasks;
-    int remainder = n_trees % numtasks;
-    
-    // ind de incio e fim para este processo
-    int start_tree = rank * trees_per_process + (rank < remainder ? rank : remainder);
-    int end_tree = start_tree + trees_per_process + (rank < remainder ? 1 : 0);
+
+    int start_tree, end_tree;
+    local_tree_range(params->n_estimators, &start_tree, &end_tree);
     int local_n_trees = end_tree - start_tree;
 
     log_if_level(1, "Rank %d: building trees [%d, %d] (%d trees)\n", 
@@ -74,106 +326,243 @@ const DecisionTreeNode **train_model(double **data,
     const DecisionTreeNode **random_forest = (const DecisionTreeNode **)
         malloc(sizeof(DecisionTreeNode *) * local_n_trees); 
 
-    // Node ID generator. We use this such that every node in the tree gets assigned a strictly
-    // increasing ID for debugging.
-    long nodeId = 0;
+    // Every tree gets its own generator keyed on the tree's global id, so the trees don't depend on
+    // which rank or thread builds them, or in which order.
+    TreeTask *tasks = malloc(sizeof(TreeTask) * local_n_trees);
+    for (int i = 0; i < local_n_trees; ++i)
+    {
+        tasks[i] = (TreeTask){
+            .data = data,
+            .params = params,
+            .csv_dim = csv_dim,
+            .ctx = ctx,
+            .tree_id = start_tree + i,
+            .root = &random_forest[i]};
+        rng_init(&tasks[i].rng, params->seed, (uint32_t)ctx->testingFoldIdx, (uint32_t)(start_tree + i), 0);
+    }
 
     // Populate the array with allocated memory for the random forest with pointers to individual decision
-    // trees.
-    for (int i = 0; i < local_n_trees; ++i)
+    // trees, building them on the worker threads if there are any.
+    if (tree_pool)
     {
-        int tree_id = start_tree + i;
-    
-        unsigned int tree_seed;
-        MPI_Bcast(&tree_seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-        
-        if (rank == 0) {
-            tree_seed = rand();
-        }
-        
-        MPI_Bcast(&tree_seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-        srand(tree_seed + tree_id);
-        
-        log_if_level(2, "Rank %d: building global tree %d (local %d)\n", 
-                     rank, tree_id, i);
-        
-        random_forest[i] = train_model_tree(data, params, csv_dim, &nodeId, ctx);
+        TaskGroup trees = TASK_GROUP_INIT;
+        for (int i = 0; i < local_n_trees; ++i)
+            thread_pool_submit(tree_pool, &trees, build_tree_task, &tasks[i]);
+        thread_pool_wait(tree_pool, &trees);
+    }
+    else
+    {
+        for (int i = 0; i < local_n_trees; ++i)
+            build_tree_task(&tasks[i]);
     }
+    free(tasks);
+    release_split_scratch();
     
     log_if_level(1, "Rank %d: completed construction of %d trees\n", rank, local_n_trees);
+    finish_fold_work(ctx->testingFoldIdx);
     
     return random_forest;
 }
 
-int predict_model(const DecisionTreeNode ***random_forest, size_t n_estimators, double *row)
+const DecisionTreeNode **train_model_hist(HistWorkspace *ws,
+                                          const RandomForestParameters *params,
+                                          const ModelContext *ctx)
 {
-    int rank, numtasks;
+    int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
-  
-    // calcula quantas arvores cada processo vai construir
-    int trees_per_process = n_estimators / numtasks;
-    int remainder = n_estimators % numtasks;
-    
-    // ind de incio e fim para este processo
-    int start_tree = rank * trees_per_process + (rank < remainder ? rank : remainder);
-    int end_tree = start_tree + trees_per_process + (rank < remainder ? 1 : 0);
+
+    // Row sharded ranks build every tree together instead of splitting the trees among them.
+    int start_tree = 0, end_tree = params->n_estimators;
+    if (!ws->row_sharded)
+        local_tree_range(params->n_estimators, &start_tree, &end_tree);
     int local_n_trees = end_tree - start_tree;
 
-    int zeroes = 0;
-    int ones = 0;
-    
+    log_if_level(1, "Rank %d: streaming trees [%d, %d] (%d trees)\n",
+                 rank, start_tree, end_tree, local_n_trees);
+
+    const DecisionTreeNode **random_forest = (const DecisionTreeNode **)
+        malloc(sizeof(DecisionTreeNode *) * local_n_trees);
+
     for (int i = 0; i < local_n_trees; ++i)
+    {
+        int tree_id = start_tree + i;
+        RandomState rng;
+        rng_init(&rng, params->seed, (uint32_t)ctx->testingFoldIdx, (uint32_t)tree_id, 0);
+
+        log_if_level(2, "Rank %d: streaming global tree %d (local %d)\n",
+                     rank, tree_id, i);
+
+        NodeArena arena;
+        node_arena_init(&arena);
+        int64_t tree_start = timer_now();
+        random_forest[i] = train_model_tree_hist(ws, params, &arena, ctx, &rng);
+        timer_add(PHASE_TREE, tree_start);
+        record_tree_work(tree_id, random_forest[i], &arena, (double)(timer_now() - tree_start) / 1e9);
+        node_arena_finish(&arena);
+    }
+
+    log_if_level(1, "Rank %d: completed construction of %d trees\n", rank, local_n_trees);
+    finish_fold_work(ctx->testingFoldIdx);
+
+    return random_forest;
+}
+
+/*
+Adds the votes of the first 'n_trees' trees of 'random_forest' for 'row' to the 'n_classes' counts
+of 'votes'.
+*/
+static void count_votes(const DecisionTreeNode **random_forest, int n_trees, double *row, size_t n_classes, int *votes)
+{
+    for (int i = 0; i < n_trees; ++i)
     {
         int prediction;
-        make_prediction((*random_forest)[i] /* root of the tree */,
+        make_prediction(random_forest[i] /* root of the tree */,
                         row,
                         &prediction);
 
-        if (prediction == 0)
-            zeroes++;
-        else if (prediction == 1)
-            ones++;
-        else
+        if (prediction < 0 || (size_t)prediction >= n_classes)
         {
-            printf("Error: currently only support binary classification, i.e. prediction values 0/1, got: %d\n",
-                   prediction);
+            printf("Error: prediction values must be in [0, %zu), got: %d\n", n_classes, prediction);
             exit(1);
         }
+        votes[prediction]++;
     }
-    
-    // combinar os votos de todos os processos
-    int global_zeroes = 0;
-    int global_ones = 0;
-    
-    MPI_Allreduce(&zeroes, &global_zeroes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(&ones, &global_ones, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    
-    if (global_ones > global_zeroes)
-        return 1;
-    else
-        return 0;
+}
+
+/*
+Class with the most of the 'n_classes' 'votes'. Ties go to the smaller class value.
+*/
+static int majority_vote(const int *votes, size_t n_classes)
+{
+    size_t best = 0;
+    for (size_t c = 1; c < n_classes; ++c)
+    {
+        if (votes[c] > votes[best])
+            best = c;
+    }
+    return (int)best;
+}
+
+void predict_model_batch(const DecisionTreeNode ***random_forest,
+                         size_t n_estimators,
+                         size_t n_classes,
+                         double **rows,
+                         size_t n_rows,
+                         int *predictions)
+{
+    int start_tree, end_tree;
+    local_tree_range(n_estimators, &start_tree, &end_tree);
+    int local_n_trees = end_tree - start_tree;
+
+    if ((double)n_rows * (double)n_classes > (double)INT_MAX)
+    {
+        printf("Error: can't combine the votes of %zu rows and %zu classes in one batch\n", n_rows, n_classes);
+        exit(1);
+    }
+
+    int *votes = calloc(n_rows * n_classes + 1, sizeof(int));
+    if (casts_votes())
+    {
+        for (size_t r = 0; r < n_rows; ++r)
+            count_votes(*random_forest, local_n_trees, rows[r], n_classes, votes + r * n_classes);
+    }
+
+    // combinar os votos de todos os processos, uma unica reducao para todo o lote
+    int64_t reduce_start = timer_now();
+    MPI_Allreduce(MPI_IN_PLACE, votes, (int)(n_rows * n_classes), MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    timer_add(PHASE_REDUCE, reduce_start);
+
+    for (size_t r = 0; r < n_rows; ++r)
+        predictions[r] = majority_vote(votes + r * n_classes, n_classes);
+    free(votes);
+}
+
+void predict_model_regression_batch(const DecisionTreeNode ***random_forest,
+                                    size_t n_estimators,
+                                    double **rows,
+                                    size_t n_rows,
+                                    double *predictions)
+{
+    int start_tree, end_tree;
+    local_tree_range(n_estimators, &start_tree, &end_tree);
+    int local_n_trees = end_tree - start_tree;
+
+    if (n_rows > (size_t)INT_MAX)
+    {
+        printf("Error: can't combine the predictions of %zu rows in one batch\n", n_rows);
+        exit(1);
+    }
+
+    double *sums = calloc(n_rows + 1, sizeof(double));
+    if (casts_votes())
+    {
+        for (size_t r = 0; r < n_rows; ++r)
+        {
+            for (int i = 0; i < local_n_trees; ++i)
+            {
+                double prediction;
+                make_prediction_value((*random_forest)[i], rows[r], &prediction);
+                sums[r] += prediction;
+            }
+        }
+    }
+
+    // somar as previsoes de todos os processos no rank 0, uma unica reducao para todo o lote
+    int64_t reduce_start = timer_now();
+    MPI_Reduce(sums, predictions, (int)n_rows, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    timer_add(PHASE_REDUCE, reduce_start);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0)
+    {
+        for (size_t r = 0; r < n_rows; ++r)
+            predictions[r] /= (double)n_estimators;
+    }
+    free(sums);
+}
+
+int predict_model(const DecisionTreeNode ***random_forest, size_t n_estimators, size_t n_classes, double *row)
+{
+    int prediction;
+    predict_model_batch(random_forest, n_estimators, n_classes, &row, 1, &prediction);
+    return prediction;
+}
+
+int predict_model_replicated(const DecisionTreeNode **random_forest, size_t n_estimators, size_t n_classes, double *row)
+{
+    int *votes = calloc(n_classes, sizeof(int));
+    count_votes(random_forest, (int)n_estimators, row, n_classes, votes);
+
+    int prediction = majority_vote(votes, n_classes);
+    free(votes);
+    return prediction;
+}
+
+void free_replicated_random_forest(const DecisionTreeNode ***random_forest, const size_t length)
+{
+    long freeCount = 0;
+    for (size_t idx = 0; idx < length; ++idx)
+        free_decision_tree_node((*random_forest)[idx], &freeCount);
+    free(*random_forest);
+
+    log_if_level(2, "total DecisionTreeNode free: %ld\n", freeCount);
 }
 
 void free_random_forest(const DecisionTreeNode ***random_forest, const size_t length)
 {
-    int rank, numtasks;
+    int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
 
     // cada processo libera apenas suas arvores locais
-    int trees_per_process = length / numtasks;
-    int remainder = length % numtasks;
-    
-    // ind de incio e fim para este processo
-    int start_tree = rank * trees_per_process + (rank < remainder ? rank : remainder);
-    int end_tree = start_tree + trees_per_process + (rank < remainder ? 1 : 0);
+    int start_tree, end_tree;
+    local_tree_range(length, &start_tree, &end_tree);
     int local_n_trees = end_tree - start_tree;
 
     long freeCount = 0;
     for (int idx = 0; idx < local_n_trees; ++idx)
     {
-        // Recursively free this DecisionTree rooted at the current node.
+        // Free the node chunks of the DecisionTree rooted at the current node.
         free_decision_tree_node((*random_forest)[idx], &freeCount);
     }
     // Free the actual array of pointers to the nodes.
@@ -184,9 +573,10 @@ void free_random_forest(const DecisionTreeNode ***random_forest, const size_t le
 
 void print_params(const RandomForestParameters *params)
 {
-    printf("using RandomForestParameters:\n  n_estimators: %ld\n  max_depth: %ld\n  min_samples_leaf: %ld\n  max_features: %ld\n",
+    printf("using RandomForestParameters:\n  n_estimators: %ld\n  max_depth: %ld\n  min_samples_leaf: %ld\n  max_features: %ld\n  n_classes: %ld\n",
            params->n_estimators,
            params->max_depth,
            params->min_samples_leaf,
-           params->max_features);
+           params->max_features,
+           params->n_classes);
 }
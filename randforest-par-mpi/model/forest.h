@@ -19,10 +19,39 @@ struct RandomForestParameters
     size_t max_depth;        // Maximum depth of a tree.
     size_t min_samples_leaf; // Minimum number of data samples at a leaf node.
     size_t max_features;     // Number of features considered when calculating the best data split.
+    size_t n_bins;           // Histogram bins per feature used by out-of-core (streaming) training.
+    unsigned int seed;       // Seed of the generators of every tree (see 'rng_init').
+    size_t n_classes;        // Class targets are the integers [0, n_classes), see 'count_classes'.
+                             // Streaming training finds it from the labels it loads instead.
+    int regression;          // Fit real valued targets, splitting on variance reduction.
+    int extra_trees;         // Extremely randomized trees, see 'calculate_best_data_split'.
+    size_t quantile_rows;    // Nodes with more rows only try 'n_quantiles' thresholds per feature,
+    size_t n_quantiles;      // 0 tries every distinct value in every node.
+    int level_wise;          // Build trees breadth first with 'grow_level_wise'.
+    size_t max_leaves;       // Leaves of a tree, and rows times features scanned by its split
+    size_t split_budget;     // searches; either one grows trees best first ('grow_best_first').
 };
 
 typedef struct RandomForestParameters RandomForestParameters;
 
+/*
+Makes groups of 'ranks' consecutive MPI ranks build each tree together, splitting the features
+sampled at every node between them (see 'set_split_comm'). The trees of the forest are then divided
+among the groups instead of among single ranks, which gives intra-tree parallelism when there are
+fewer trees than ranks. Collective over MPI_COMM_WORLD.
+*/
+void set_feature_parallel_ranks(int ranks);
+
+/*
+Builds the trees of this rank on a pool of 'n_threads' worker threads sharing one copy of the
+data, instead of one after the other on the calling thread. 1 stops the pool. Unless
+'subtree_cutoff' is 0, subtrees of at least that many rows become tasks of their own that idle
+workers steal, so the pool stays busy when there are fewer trees left than threads (see
+'set_subtree_pool'). Only applies to the in-memory trainer, and can't be combined with
+'set_feature_parallel_ranks'.
+*/
+void set_tree_threads(int n_threads, size_t subtree_cutoff);
+
 /*
 Function to print a RandomForestParameters struct for debugging.
 */
@@ -36,8 +65,9 @@ const DecisionTreeNode *
 train_model_tree(double **data,
                  const RandomForestParameters *params,
                  const struct dim *csv_dim,
-                 long *nodeId /* Ascending node ID generator */,
-                 const ModelContext *ctx);
+                 NodeArena *arena /* Allocator and ID generator of the tree's nodes */,
+                 const ModelContext *ctx,
+                 RandomState *rng);
 
 /*
 Trains a random forest model that is comprised of individually built decision trees. Returns an array 
@@ -48,16 +78,55 @@ const DecisionTreeNode **train_model(double **data,
                                      const struct dim *csv_dim,
                                      const ModelContext *ctx);
 
+/*
+Sums the work counted while building the trees of a cross validation (see 'TreeStats') over all
+ranks and prints it on rank 0 when 'log_level' is above 1, then starts counting anew. 'train_model'
+and 'train_model_hist' report the work of every fold the same way, and print the work of every tree
+at the same level. Ranks that build trees together (see 'set_feature_parallel_ranks') each count the
+trees they share. Collective.
+*/
+void report_cross_validation_work(void);
+
 /*
 Given a single row, gets predictions from every decision tree in the 'random_forest' model
 for the class target that the row should be classified into and returns the class target value
-that is the majority vote.
+that is the majority vote. Ties go to the smaller class value.
 */
-int predict_model(const DecisionTreeNode ***random_forest, size_t n_estimators, double *row);
+int predict_model(const DecisionTreeNode ***random_forest, size_t n_estimators, size_t n_classes, double *row);
+
+/*
+Batch version of 'predict_model': writes the majority vote for each of the 'n_rows' rows of 'rows'
+to 'predictions'. The 'n_rows' * 'n_classes' vote counts of all processes are summed with a single
+MPI_Allreduce for the whole batch, rather than one per row.
+*/
+void predict_model_batch(const DecisionTreeNode ***random_forest,
+                         size_t n_estimators,
+                         size_t n_classes,
+                         double **rows,
+                         size_t n_rows,
+                         int *predictions);
+
+/*
+Regression counterpart of 'predict_model_batch': averages the predictions of all trees for each of
+the 'n_rows' rows of 'rows'. The per-row sums of all processes are combined with a single MPI_Reduce,
+so 'predictions' is only written on rank 0.
+*/
+void predict_model_regression_batch(const DecisionTreeNode ***random_forest,
+                                    size_t n_estimators,
+                                    double **rows,
+                                    size_t n_rows,
+                                    double *predictions);
 
 /*
 Frees memory for a given random forest model (array of pointers to DecisionTreeNode's).
 */
 void free_random_forest(const DecisionTreeNode ***random_forest, const size_t length);
 
+/*
+Counterparts of 'predict_model' and 'free_random_forest' for a forest of which this process holds
+all 'n_estimators' trees (as after row sharded training), so no votes need to be exchanged.
+*/
+int predict_model_replicated(const DecisionTreeNode **random_forest, size_t n_estimators, size_t n_classes, double *row);
+void free_replicated_random_forest(const DecisionTreeNode ***random_forest, const size_t length);
+
 #endif // forest_h
@@ -0,0 +1,660 @@
+/*
+Histogram based, level-wise decision tree construction over a ColumnSource.
+*/
+
+#include <string.h>
+#include <mpi.h>
+#include "hist.h"
+#include "../utils/timer.h"
+
+/*
+A node of the tree level being built, waiting for its split to be chosen.
+*/
+typedef struct FrontierEntry
+{
+    DecisionTreeNode *parent; // NULL for the root.
+    int side;                 // 0 when the node is the left child of 'parent', 1 when it is the right one.
+    size_t depth;
+    size_t n;                 // Training rows reaching the node.
+    RandomState rng;          // Generator of the node, drawing its sampled features.
+} FrontierEntry;
+
+/*
+The split chosen for a frontier entry.
+*/
+typedef struct EntrySplit
+{
+    int feature;  // -1 if no split separates the rows of the entry.
+    double value;
+    double gini;
+} EntrySplit;
+
+FeatureBins alloc_feature_bins(size_t n_features, size_t n_bins)
+{
+    FeatureBins bins;
+    bins.n_features = n_features;
+    bins.max_edges = n_bins > 1 ? n_bins - 1 : 1;
+    bins.n_edges = calloc(n_features, sizeof(size_t));
+    bins.edges = malloc(n_features * bins.max_edges * sizeof(double));
+    return bins;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+FeatureBins compute_feature_bins(const ColumnSource *src, size_t n_bins)
+{
+    size_t rows = src->dim.rows;
+    FeatureBins bins = alloc_feature_bins(src->dim.cols - 1, n_bins);
+
+    // Read the sample as a few contiguous blocks spread evenly over the rows, which keeps the
+    // number of disk seeks small while still covering the whole source.
+    size_t sample_rows = rows < BIN_SAMPLE_ROWS ? rows : BIN_SAMPLE_ROWS;
+    size_t block = sample_rows < 4096 ? sample_rows : 4096;
+    size_t n_blocks = (sample_rows + block - 1) / block;
+    double *sample = malloc(sample_rows * sizeof(double));
+
+    for (size_t f = 0; f < bins.n_features; ++f)
+    {
+        size_t n = 0;
+        for (size_t b = 0; b < n_blocks; ++b)
+        {
+            size_t begin = (b * rows) / n_blocks;
+            size_t count = block;
+            if (count > rows - begin)
+                count = rows - begin;
+            if (count > sample_rows - n)
+                count = sample_rows - n;
+            src->read_column(src, f, begin, count, sample + n);
+            n += count;
+        }
+        qsort(sample, n, sizeof(double), compare_doubles);
+
+        // Quantile edges, skipping duplicates and any edge that would leave its left side empty.
+        double *edges = bins.edges + f * bins.max_edges;
+        size_t n_edges = 0;
+        for (size_t k = 1; k <= bins.max_edges; ++k)
+        {
+            double edge = sample[(k * n) / (bins.max_edges + 1)];
+            if (edge <= sample[0] || (n_edges > 0 && edge <= edges[n_edges - 1]))
+                continue;
+            edges[n_edges++] = edge;
+        }
+        bins.n_edges[f] = n_edges;
+    }
+
+    free(sample);
+    return bins;
+}
+
+void free_feature_bins(FeatureBins *bins)
+{
+    free(bins->n_edges);
+    free(bins->edges);
+    bins->n_edges = NULL;
+    bins->edges = NULL;
+}
+
+FeatureBins broadcast_feature_bins(const ColumnSource *src, size_t n_bins)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    size_t n_features = src->dim.cols - 1;
+    FeatureBins bins;
+    if (rank == 0)
+        bins = compute_feature_bins(src, n_bins);
+    else
+        bins = alloc_feature_bins(n_features, n_bins);
+
+    MPI_Bcast(bins.n_edges, (int)n_features, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+    MPI_Bcast(bins.edges, (int)(n_features * bins.max_edges), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    return bins;
+}
+
+HistWorkspace hist_workspace_create(const ColumnSource *src,
+                                    const FeatureBins *bins,
+                                    size_t mem_budget,
+                                    int row_sharded)
+{
+    size_t rows = src->dim.rows;
+    size_t cols = src->dim.cols;
+
+    size_t fixed_bytes = rows * (sizeof(unsigned char) + sizeof(int)) +
+                         bins->n_features * (sizeof(size_t) + bins->max_edges * sizeof(double));
+    if (fixed_bytes >= mem_budget)
+    {
+        printf("Error: memory budget of %zu bytes cannot hold the %zu bytes of per-row state for %zu rows\n",
+               mem_budget, fixed_bytes, rows);
+        exit(1);
+    }
+
+    // Split what is left of the budget evenly between the column buffer and the histograms.
+    size_t remaining = mem_budget - fixed_bytes;
+    size_t chunk_rows = remaining / 2 / sizeof(double);
+    if (chunk_rows == 0)
+    {
+        printf("Error: memory budget of %zu bytes leaves no room for a streaming buffer\n", mem_budget);
+        exit(1);
+    }
+    if (chunk_rows > rows)
+        chunk_rows = rows > 0 ? rows : 1;
+    size_t hist_bytes = remaining - chunk_rows * sizeof(double);
+
+    // Sharded ranks reduce their histograms together, so they must all cut a level into the
+    // same passes: use the smallest histogram budget of any rank.
+    if (row_sharded)
+    {
+        unsigned long local_bytes = hist_bytes, min_bytes;
+        MPI_Allreduce(&local_bytes, &min_bytes, 1, MPI_UNSIGNED_LONG, MPI_MIN, MPI_COMM_WORLD);
+        hist_bytes = min_bytes;
+    }
+
+    HistWorkspace ws = {
+        .src = src,
+        .bins = bins,
+        .n_classes = 0,
+        .row_sharded = row_sharded,
+        .labels = malloc(rows * sizeof(unsigned char)),
+        .assign = malloc(rows * sizeof(int)),
+        .buffer = malloc(chunk_rows * sizeof(double)),
+        .chunk_rows = chunk_rows,
+        .hist_bytes = hist_bytes};
+
+    for (size_t begin = 0; begin < rows; begin += chunk_rows)
+    {
+        size_t count = rows - begin < chunk_rows ? rows - begin : chunk_rows;
+        src->read_column(src, cols - 1, begin, count, ws.buffer);
+        for (size_t i = 0; i < count; ++i)
+        {
+            double class_label = ws.buffer[i];
+            if (class_label < 0 || class_label > UCHAR_MAX || class_label != (double)(int)class_label)
+            {
+                printf("Error: streaming training supports class target values 0..%d, got: %f\n",
+                       UCHAR_MAX, class_label);
+                exit(1);
+            }
+            ws.labels[begin + i] = (unsigned char)class_label;
+            if ((size_t)class_label + 1 > ws.n_classes)
+                ws.n_classes = (size_t)class_label + 1;
+        }
+    }
+
+    // A shard may not hold every class.
+    if (row_sharded)
+    {
+        unsigned long n_classes = ws.n_classes;
+        MPI_Allreduce(MPI_IN_PLACE, &n_classes, 1, MPI_UNSIGNED_LONG, MPI_MAX, MPI_COMM_WORLD);
+        ws.n_classes = n_classes;
+    }
+
+    log_if_level(1, "streaming workspace: %zu classes, %zu rows per chunk, %zu bytes for histograms\n",
+                 ws.n_classes, ws.chunk_rows, ws.hist_bytes);
+
+    return ws;
+}
+
+void free_hist_workspace(HistWorkspace *ws)
+{
+    free(ws->labels);
+    free(ws->assign);
+    free(ws->buffer);
+    ws->labels = NULL;
+    ws->assign = NULL;
+    ws->buffer = NULL;
+}
+
+/*
+Returns the bin of 'x', i.e. the number of 'edges' that are <= x.
+*/
+static size_t find_bin(double x, const double *edges, size_t n_edges)
+{
+    size_t lo = 0;
+    size_t hi = n_edges;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (edges[mid] <= x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+Majority class of 'counts'. Ties go to the larger class value, as in 'get_leaf_node_class_value'.
+*/
+static int majority_class(const long *counts, size_t n_classes)
+{
+    size_t best = 0;
+    for (size_t c = 1; c < n_classes; ++c)
+    {
+        if (counts[c] >= counts[best])
+            best = c;
+    }
+    return (int)best;
+}
+
+/*
+Streams every column used by the entries [first, last) and accumulates their class histograms
+into 'hist', laid out as [entry - first][sampled feature][bin][class]. Returns the number of values
+binned.
+*/
+static size_t fill_histograms(HistWorkspace *ws,
+                            const int *features,
+                            size_t max_features,
+                            size_t first,
+                            size_t last,
+                            int *slot,
+                            long *hist)
+{
+    const ColumnSource *src = ws->src;
+    const FeatureBins *bins = ws->bins;
+    size_t n_features = bins->n_features;
+    size_t n_bins = bins->max_edges + 1;
+    size_t K = ws->n_classes;
+    size_t rows = src->dim.rows;
+    size_t binned = 0;
+
+    // 'slot' maps (entry, feature) to the position of the feature in the entry's sample.
+    for (size_t i = 0; i < (last - first) * n_features; ++i)
+        slot[i] = -1;
+    for (size_t e = first; e < last; ++e)
+        for (size_t j = 0; j < max_features; ++j)
+            slot[(e - first) * n_features + features[e * max_features + j]] = (int)j;
+
+    for (size_t f = 0; f < n_features; ++f)
+    {
+        int used = 0;
+        for (size_t e = first; e < last && !used; ++e)
+            used = slot[(e - first) * n_features + f] >= 0;
+        if (!used)
+            continue;
+
+        const double *edges = bins->edges + f * bins->max_edges;
+        size_t n_edges = bins->n_edges[f];
+
+        for (size_t begin = 0; begin < rows; begin += ws->chunk_rows)
+        {
+            size_t count = rows - begin < ws->chunk_rows ? rows - begin : ws->chunk_rows;
+            src->read_column(src, f, begin, count, ws->buffer);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                int e = ws->assign[begin + i];
+                if (e < (int)first || e >= (int)last)
+                    continue;
+                int j = slot[(e - first) * n_features + f];
+                if (j < 0)
+                    continue;
+                size_t bin = find_bin(ws->buffer[i], edges, n_edges);
+                hist[(((e - first) * max_features + j) * n_bins + bin) * K + ws->labels[begin + i]]++;
+                ++binned;
+            }
+        }
+    }
+    return binned;
+}
+
+/*
+Picks the lowest gini split of entry 'e' from its histograms and writes the class counts of the
+left half into 'left_counts'. 'scratch' holds 2 * 'n_classes' counts. Adds the number of thresholds
+scored to 'candidates'.
+*/
+static EntrySplit best_split_from_histograms(const HistWorkspace *ws,
+                                             const int *features,
+                                             size_t max_features,
+                                             const long *entry_hist,
+                                             const long *counts,
+                                             size_t n,
+                                             long *left_counts,
+                                             long *scratch,
+                                             long *candidates)
+{
+    const FeatureBins *bins = ws->bins;
+    size_t n_bins = bins->max_edges + 1;
+    size_t K = ws->n_classes;
+
+    EntrySplit best = {.feature = -1, .value = DBL_MAX, .gini = DBL_MAX};
+    long *left = scratch;
+    long *right = scratch + K;
+
+    for (size_t j = 0; j < max_features; ++j)
+    {
+        int f = features[j];
+        const long *feature_hist = entry_hist + j * n_bins * K;
+        const double *edges = bins->edges + f * bins->max_edges;
+
+        memset(left, 0, K * sizeof(long));
+        size_t n_left = 0;
+
+        // Split "x < edge k" sends bins 0..k left.
+        for (size_t k = 0; k < bins->n_edges[f]; ++k)
+        {
+            for (size_t c = 0; c < K; ++c)
+            {
+                left[c] += feature_hist[k * K + c];
+                n_left += feature_hist[k * K + c];
+            }
+            if (n_left == 0 || n_left == n)
+                continue;
+
+            for (size_t c = 0; c < K; ++c)
+                right[c] = counts[c] - left[c];
+
+            size_t n_right = n - n_left;
+            ++*candidates;
+            double gini = gini_from_counts(left, K, n_left) * ((double)n_left / (double)n) +
+                          gini_from_counts(right, K, n_right) * ((double)n_right / (double)n);
+            if (gini < best.gini)
+            {
+                best = (EntrySplit){.feature = f, .value = edges[k], .gini = gini};
+                memcpy(left_counts, left, K * sizeof(long));
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+Moves every row of the level to the frontier entry of the next level it belongs to, streaming
+only the columns that some split of the level uses. Rows that reached a leaf become -1. Returns the
+number of rows moved.
+*/
+static size_t route_rows(HistWorkspace *ws, const EntrySplit *splits, const int *children, size_t n_entries)
+{
+    const ColumnSource *src = ws->src;
+    size_t rows = src->dim.rows;
+    size_t n_features = ws->bins->n_features;
+    size_t moved = 0;
+
+    // While routing, already moved rows are encoded as -(next + 2) so they can't be mistaken for
+    // rows of a current entry with the same index.
+    for (size_t i = 0; i < rows; ++i)
+    {
+        int e = ws->assign[i];
+        if (e >= 0 && children[2 * e] < 0 && children[2 * e + 1] < 0)
+            ws->assign[i] = -1;
+    }
+
+    for (size_t f = 0; f < n_features; ++f)
+    {
+        int used = 0;
+        for (size_t e = 0; e < n_entries && !used; ++e)
+            used = splits[e].feature == (int)f && (children[2 * e] >= 0 || children[2 * e + 1] >= 0);
+        if (!used)
+            continue;
+
+        for (size_t begin = 0; begin < rows; begin += ws->chunk_rows)
+        {
+            size_t count = rows - begin < ws->chunk_rows ? rows - begin : ws->chunk_rows;
+            src->read_column(src, f, begin, count, ws->buffer);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                int e = ws->assign[begin + i];
+                if (e < 0 || splits[e].feature != (int)f)
+                    continue;
+                int side = ws->buffer[i] < splits[e].value ? 0 : 1;
+                int next = children[2 * e + side];
+                ws->assign[begin + i] = next < 0 ? -1 : -(next + 2);
+                ++moved;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < rows; ++i)
+    {
+        if (ws->assign[i] <= -2)
+            ws->assign[i] = -ws->assign[i] - 2;
+    }
+    return moved;
+}
+
+/*
+Most entries any level of a tree can hold: level 'd' has at most 2^(d - 1) of them, and every entry
+below the root has more than 'min_samples_leaf' of the 'n' training rows, none shared with another.
+*/
+static size_t max_frontier_entries(const RandomForestParameters *params, size_t n)
+{
+    size_t by_rows = n / (params->min_samples_leaf + 1);
+    size_t by_depth = params->max_depth - 1 < sizeof(size_t) * 8 - 1 ? (size_t)1 << (params->max_depth - 1) : SIZE_MAX;
+    size_t entries = by_rows < by_depth ? by_rows : by_depth;
+    return entries > 0 ? entries : 1;
+}
+
+const DecisionTreeNode *train_model_tree_hist(HistWorkspace *ws,
+                                              const RandomForestParameters *params,
+                                              NodeArena *arena,
+                                              const ModelContext *ctx,
+                                              RandomState *rng)
+{
+    const ColumnSource *src = ws->src;
+    size_t rows = src->dim.rows;
+    size_t cols = src->dim.cols;
+    size_t n_features = ws->bins->n_features;
+    size_t n_bins = ws->bins->max_edges + 1;
+    size_t K = ws->n_classes;
+    size_t max_features = params->max_features < n_features ? params->max_features : n_features;
+
+    // Every training row starts at the root, rows of the testing fold are never visited.
+    size_t test_begin = ctx->testingFoldIdx * ctx->rowsPerFold;
+    size_t test_end = test_begin + ctx->rowsPerFold;
+
+    long *root_counts = calloc(K, sizeof(long));
+    size_t root_n = 0;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        size_t row = src->row_offset + i;
+        if (row >= test_begin && row < test_end)
+        {
+            ws->assign[i] = -1;
+            continue;
+        }
+        ws->assign[i] = 0;
+        root_counts[ws->labels[i]]++;
+        root_n++;
+    }
+
+    if (ws->row_sharded)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, root_counts, (int)K, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+        unsigned long n = root_n;
+        MPI_Allreduce(MPI_IN_PLACE, &n, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+        root_n = n;
+    }
+
+    // The frontier of every level is built in buffers sized once for the widest possible level,
+    // which are charged to the histogram budget. 'root_n' and the parameters are the same on every
+    // rank, so sharded ranks still agree on the histogram passes. The counts of the next level get
+    // one spare slot, as both sides of a split are counted in place before one is dropped.
+    size_t max_entries = max_frontier_entries(params, root_n);
+    size_t frontier_bytes = 2 * max_entries * sizeof(FrontierEntry) +
+                            (2 * max_entries + 1) * K * sizeof(long) +
+                            max_entries * (max_features * sizeof(int) + sizeof(EntrySplit) + K * sizeof(long)) +
+                            2 * max_entries * sizeof(int) +
+                            2 * K * sizeof(long);
+    if (frontier_bytes >= ws->hist_bytes)
+    {
+        printf("Error: memory budget leaves %zu bytes for histograms, less than the %zu bytes of the frontier of "
+               "up to %zu nodes per level, lower --max_depth or raise --mem_budget\n",
+               ws->hist_bytes, frontier_bytes, max_entries);
+        exit(1);
+    }
+
+    FrontierEntry *entries = malloc(max_entries * sizeof(FrontierEntry));
+    FrontierEntry *next_entries = malloc(max_entries * sizeof(FrontierEntry));
+    long *counts = malloc((max_entries + 1) * K * sizeof(long));
+    long *next_counts = malloc((max_entries + 1) * K * sizeof(long));
+    int *features = malloc(max_entries * max_features * sizeof(int));
+    EntrySplit *splits = malloc(max_entries * sizeof(EntrySplit));
+    long *left_counts = malloc(max_entries * K * sizeof(long));
+    int *children = malloc(2 * max_entries * sizeof(int));
+    long *split_scratch = malloc(2 * K * sizeof(long));
+
+    entries[0] = (FrontierEntry){.parent = NULL, .side = 0, .depth = 1, .n = root_n, .rng = *rng};
+    memcpy(counts, root_counts, K * sizeof(long));
+    free(root_counts);
+    size_t n_entries = 1;
+
+    DecisionTreeNode *root = NULL;
+
+    TreeStats work = {0};
+    work.bytes += (long)frontier_bytes;
+
+    // Histogram and slot memory of a single entry, which bounds how many entries share one
+    // streaming pass within what the frontier leaves of the budget.
+    size_t entry_hist_bytes = max_features * n_bins * K * sizeof(long);
+    size_t entry_pass_bytes = entry_hist_bytes + n_features * sizeof(int);
+    size_t batch = (ws->hist_bytes - frontier_bytes) / entry_pass_bytes;
+    if (batch == 0)
+        batch = 1;
+
+    while (n_entries > 0)
+    {
+        for (size_t e = 0; e < n_entries; ++e)
+            sample_features(features + e * max_features, max_features, cols, &entries[e].rng);
+
+        memset(left_counts, 0, n_entries * K * sizeof(long));
+
+        size_t batch_entries = batch < n_entries ? batch : n_entries;
+        int *slot = malloc(batch_entries * n_features * sizeof(int));
+        long *hist = malloc(batch_entries * entry_hist_bytes);
+        work.bytes += (long)(batch_entries * entry_pass_bytes);
+
+        for (size_t first = 0; first < n_entries; first += batch_entries)
+        {
+            size_t last = first + batch_entries < n_entries ? first + batch_entries : n_entries;
+            memset(hist, 0, (last - first) * entry_hist_bytes);
+
+            work.rows_scanned += (long)fill_histograms(ws, features, max_features, first, last, slot, hist);
+
+            // Each rank only saw its own rows: sum the histograms so that every rank picks the
+            // same splits from the statistics of all rows.
+            if (ws->row_sharded)
+            {
+                int64_t reduce_start = timer_now();
+                MPI_Allreduce(MPI_IN_PLACE,
+                              hist,
+                              (int)((last - first) * entry_hist_bytes / sizeof(long)),
+                              MPI_LONG,
+                              MPI_SUM,
+                              MPI_COMM_WORLD);
+                timer_add(PHASE_REDUCE, reduce_start);
+            }
+
+            for (size_t e = first; e < last; ++e)
+            {
+                splits[e] = best_split_from_histograms(ws,
+                                                       features + e * max_features,
+                                                       max_features,
+                                                       hist + (e - first) * max_features * n_bins * K,
+                                                       counts + e * K,
+                                                       entries[e].n,
+                                                       left_counts + e * K,
+                                                       split_scratch,
+                                                       &work.candidates);
+            }
+        }
+        free(slot);
+        free(hist);
+
+        // Turn the splits into nodes and collect the children that are themselves split next.
+        size_t n_next = 0;
+        for (size_t e = 0; e < n_entries; ++e)
+        {
+            const FrontierEntry *entry = &entries[e];
+            DecisionTreeNode *node = empty_node(arena);
+            if (entry->parent == NULL)
+                root = node;
+            else if (entry->side == 0)
+                entry->parent->leftChild = node;
+            else
+                entry->parent->rightChild = node;
+
+            children[2 * e] = -1;
+            children[2 * e + 1] = -1;
+
+            if (splits[e].feature < 0)
+            {
+                // No split separates these rows, so both sides predict the majority of the node.
+                int leaf = majority_class(counts + e * K, K);
+                node->split_index = features[e * max_features];
+                node->split_value = -DBL_MAX;
+                node->left_leaf = leaf;
+                node->right_leaf = leaf;
+                continue;
+            }
+
+            node->split_index = splits[e].feature;
+            node->split_value = splits[e].value;
+
+            long *side_counts[2] = {next_counts + n_next * K, next_counts + (n_next + 1) * K};
+            size_t side_n[2] = {0, 0};
+            for (size_t c = 0; c < K; ++c)
+            {
+                side_counts[0][c] = left_counts[e * K + c];
+                side_counts[1][c] = counts[e * K + c] - left_counts[e * K + c];
+                side_n[0] += side_counts[0][c];
+                side_n[1] += side_counts[1][c];
+            }
+
+            for (int side = 0; side < 2; ++side)
+            {
+                if (entry->depth >= params->max_depth || side_n[side] <= params->min_samples_leaf)
+                {
+                    int leaf = majority_class(side_counts[side], K);
+                    if (side == 0)
+                        node->left_leaf = leaf;
+                    else
+                        node->right_leaf = leaf;
+                    continue;
+                }
+
+                // Keep the counts for this child in place at slot 'n_next'.
+                if (side_counts[side] != next_counts + n_next * K)
+                    memcpy(next_counts + n_next * K, side_counts[side], K * sizeof(long));
+                children[2 * e + side] = (int)n_next;
+                next_entries[n_next++] = (FrontierEntry){
+                    .parent = node,
+                    .side = side,
+                    .depth = entry->depth + 1,
+                    .n = side_n[side],
+                    .rng = rng_child(&entry->rng, side)};
+            }
+        }
+
+        log_if_level(2, "streaming level: %zu nodes split, %zu nodes in next level\n", n_entries, n_next);
+
+        if (n_next > 0)
+            work.rows_partitioned += (long)route_rows(ws, splits, children, n_entries);
+
+        // The next level becomes the current one.
+        FrontierEntry *swap_entries = entries;
+        entries = next_entries;
+        next_entries = swap_entries;
+        long *swap_counts = counts;
+        counts = next_counts;
+        next_counts = swap_counts;
+        n_entries = n_next;
+    }
+
+    free(entries);
+    free(next_entries);
+    free(counts);
+    free(next_counts);
+    free(features);
+    free(splits);
+    free(left_counts);
+    free(children);
+    free(split_scratch);
+
+    tree_stats_add(&arena->stats, &work);
+    return root;
+}
@@ -0,0 +1,112 @@
+/*
+Histogram based, level-wise decision tree construction over a ColumnSource.
+
+Instead of materializing the rows of every node, each tree level streams the sampled feature
+columns once through a bounded buffer, accumulates per-node class histograms over pre-computed
+feature bins and picks every split of the level from those histograms. Only a node assignment
+and a class label per row are kept in memory, which is what allows training on datasets that
+only exist on disk as a column store.
+*/
+
+#ifndef hist_h
+#define hist_h
+
+#include <stdlib.h>
+#include "forest.h"
+#include "../utils/colstore.h"
+
+// Rows sampled per feature to compute its bin edges.
+#define BIN_SAMPLE_ROWS 65536
+
+/*
+Bin edges of every feature. A value 'x' of feature 'f' falls into bin 'k' when exactly 'k' edges
+of 'f' are <= x, so the split "x < edge k" sends bins 0..k to the left and the rest to the right.
+*/
+struct FeatureBins
+{
+    size_t n_features; // Every column except the class target.
+    size_t max_edges;  // n_bins - 1.
+    size_t *n_edges;   // Number of distinct edges actually used by each feature.
+    double *edges;     // 'n_features' * 'max_edges', feature 'f' starts at 'f * max_edges'.
+};
+
+typedef struct FeatureBins FeatureBins;
+
+/*
+State shared by every tree trained from the same ColumnSource. All buffers are sized once from
+the memory budget when the workspace is created.
+*/
+struct HistWorkspace
+{
+    const ColumnSource *src;
+    const FeatureBins *bins;
+    size_t n_classes;      // Largest class target value of any row + 1.
+
+    // Set when 'src' is this rank's shard of the rows: every rank then builds every tree and the
+    // class histograms of each level are summed over all ranks with one MPI_Allreduce.
+    int row_sharded;
+
+    unsigned char *labels; // Class target per row.
+    int *assign;           // Frontier node per row of the level being built, -1 once settled.
+
+    double *buffer;        // Streaming buffer of 'chunk_rows' values.
+    size_t chunk_rows;
+    size_t hist_bytes;     // Budget left for the class histograms of one pass.
+};
+
+typedef struct HistWorkspace HistWorkspace;
+
+/*
+Allocates bins for 'n_features' features of at most 'n_bins' bins each.
+*/
+FeatureBins alloc_feature_bins(size_t n_features, size_t n_bins);
+
+/*
+Computes approximate quantile bin edges for every feature of 'src' from up to BIN_SAMPLE_ROWS
+rows spread evenly over the source.
+*/
+FeatureBins compute_feature_bins(const ColumnSource *src, size_t n_bins);
+
+void free_feature_bins(FeatureBins *bins);
+
+/*
+Computes the bins on rank 0 from 'src' and broadcasts them, so that every rank bins values
+identically. 'src' is only read on rank 0 and should cover the whole dataset.
+*/
+FeatureBins broadcast_feature_bins(const ColumnSource *src, size_t n_bins);
+
+/*
+Loads the class targets of 'src' and sizes the streaming buffers so that the workspace never uses
+more than 'mem_budget' bytes in total. Exits if the budget cannot hold the per-row state or a class
+target is not an integer in [0, 255]. With 'row_sharded' set this is collective, all ranks agree on
+the histogram pass size and the number of classes.
+*/
+HistWorkspace hist_workspace_create(const ColumnSource *src,
+                                    const FeatureBins *bins,
+                                    size_t mem_budget,
+                                    int row_sharded);
+
+void free_hist_workspace(HistWorkspace *ws);
+
+/*
+Trains a single decision tree level by level from the rows of 'ws' that are not part of the
+testing fold of 'ctx', where 'rng' is the generator of the root node. The tree uses the same DecisionTreeNode layout as 'train_model_tree', so
+prediction and teardown are shared with the in-memory trainer. The frontier of the widest level the
+parameters allow is charged to 'ws->hist_bytes'; exits if it does not fit.
+*/
+const DecisionTreeNode *train_model_tree_hist(HistWorkspace *ws,
+                                              const RandomForestParameters *params,
+                                              NodeArena *arena /* Allocator and ID generator of the tree's nodes */,
+                                              const ModelContext *ctx,
+                                              RandomState *rng);
+
+/*
+Streaming counterpart of 'train_model': trains this process' share of the forest's trees with
+'train_model_tree_hist' and returns them in the same layout. For a row sharded workspace every
+rank trains, and ends up holding, all 'n_estimators' trees.
+*/
+const DecisionTreeNode **train_model_hist(HistWorkspace *ws,
+                                          const RandomForestParameters *params,
+                                          const ModelContext *ctx);
+
+#endif // hist_h
@@ -0,0 +1,146 @@
+/*
+Partition kernels splitting a list of rows by the value of one feature.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include "partition.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PARTITION_X86 1
+#include <immintrin.h>
+#else
+#define PARTITION_X86 0
+#endif
+
+typedef size_t (*PartitionKernel)(double **rows, size_t n, int feature, double value, double **left, double **right);
+
+static size_t partition_scalar(double **rows, size_t n, int feature, double value, double **left, double **right)
+{
+    size_t n_left = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        // Write the row to both sides and only keep it on the side its comparison selects: the
+        // next row overwrites the other slot.
+        double *row = rows[i];
+        size_t is_left = row[feature] < value;
+        left[n_left] = row;
+        right[i - n_left] = row;
+        n_left += is_left;
+    }
+    return n_left;
+}
+
+#if PARTITION_X86
+/*
+For each 4 bit mask, the 32 bit lanes of 'permutevar8x32' moving the 64 bit lanes set in the mask to
+the front, in order.
+*/
+static const int32_t compress_lut[16][8] = {
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {2, 3, 0, 0, 0, 0, 0, 0},
+    {0, 1, 2, 3, 0, 0, 0, 0},
+    {4, 5, 0, 0, 0, 0, 0, 0},
+    {0, 1, 4, 5, 0, 0, 0, 0},
+    {2, 3, 4, 5, 0, 0, 0, 0},
+    {0, 1, 2, 3, 4, 5, 0, 0},
+    {6, 7, 0, 0, 0, 0, 0, 0},
+    {0, 1, 6, 7, 0, 0, 0, 0},
+    {2, 3, 6, 7, 0, 0, 0, 0},
+    {0, 1, 2, 3, 6, 7, 0, 0},
+    {4, 5, 6, 7, 0, 0, 0, 0},
+    {0, 1, 4, 5, 6, 7, 0, 0},
+    {2, 3, 4, 5, 6, 7, 0, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7},
+};
+
+__attribute__((target("avx2"))) static size_t partition_avx2(double **rows,
+                                                             size_t n,
+                                                             int feature,
+                                                             double value,
+                                                             double **left,
+                                                             double **right)
+{
+    const __m256d threshold = _mm256_set1_pd(value);
+    size_t n_left = 0, n_right = 0, i = 0;
+
+    // Whole 4 pointer vectors are stored, which can't overrun: neither side is ever ahead of 'i'.
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d values = _mm256_set_pd(rows[i + 3][feature], rows[i + 2][feature], rows[i + 1][feature], rows[i][feature]);
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(values, threshold, _CMP_LT_OQ));
+        __m256i ptrs = _mm256_loadu_si256((const __m256i *)(rows + i));
+
+        __m256i to_left = _mm256_loadu_si256((const __m256i *)compress_lut[mask]);
+        __m256i to_right = _mm256_loadu_si256((const __m256i *)compress_lut[~mask & 0xF]);
+        _mm256_storeu_si256((__m256i *)(left + n_left), _mm256_permutevar8x32_epi32(ptrs, to_left));
+        _mm256_storeu_si256((__m256i *)(right + n_right), _mm256_permutevar8x32_epi32(ptrs, to_right));
+
+        int block_left = __builtin_popcount(mask);
+        n_left += block_left;
+        n_right += 4 - block_left;
+    }
+    return n_left + partition_scalar(rows + i, n - i, feature, value, left + n_left, right + n_right);
+}
+
+__attribute__((target("avx512f"))) static size_t partition_avx512(double **rows,
+                                                                  size_t n,
+                                                                  int feature,
+                                                                  double value,
+                                                                  double **left,
+                                                                  double **right)
+{
+    const __m512d threshold = _mm512_set1_pd(value);
+    size_t n_left = 0, n_right = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d values = _mm512_set_pd(rows[i + 7][feature], rows[i + 6][feature], rows[i + 5][feature], rows[i + 4][feature],
+                                       rows[i + 3][feature], rows[i + 2][feature], rows[i + 1][feature], rows[i][feature]);
+        __mmask8 mask = _mm512_cmp_pd_mask(values, threshold, _CMP_LT_OQ);
+        __m512i ptrs = _mm512_loadu_si512(rows + i);
+
+        _mm512_mask_compressstoreu_epi64(left + n_left, mask, ptrs);
+        _mm512_mask_compressstoreu_epi64(right + n_right, (__mmask8)~mask, ptrs);
+
+        int block_left = __builtin_popcount(mask);
+        n_left += block_left;
+        n_right += 8 - block_left;
+    }
+    return n_left + partition_scalar(rows + i, n - i, feature, value, left + n_left, right + n_right);
+}
+#endif
+
+static PartitionKernel kernel = partition_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void select_kernel(void)
+{
+#if PARTITION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernel = partition_avx512;
+        kernel_name = "avx512";
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        kernel = partition_avx2;
+        kernel_name = "avx2";
+    }
+#endif
+}
+
+size_t partition_rows(double **rows, size_t n, int feature, double value, double **left, double **right)
+{
+    pthread_once(&kernel_once, select_kernel);
+    return kernel(rows, n, feature, value, left, right);
+}
+
+const char *partition_kernel_name(void)
+{
+    pthread_once(&kernel_once, select_kernel);
+    return kernel_name;
+}
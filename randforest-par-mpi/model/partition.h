@@ -0,0 +1,28 @@
+/*
+Partition kernels splitting a list of rows into the rows whose value of one feature is below a
+threshold and all other rows, which is the inner loop of 'split_dataset'.
+*/
+
+#ifndef partition_h
+#define partition_h
+
+#include <stdlib.h>
+
+/*
+Copies the pointers of the 'n' rows in 'rows' whose value of feature 'feature' is < 'value' to
+'left' and the others to 'right', both keeping the order of 'rows', and returns how many went to
+'left'. 'left' and 'right' must both have room for 'n' pointers.
+
+The comparison doesn't branch on the data: on x86-64 blocks of rows are compared with AVX-512 or
+AVX2 and the pointers compress stored from the resulting bitmask, otherwise every row is written to
+both sides and only the matching side's count advances. The fastest kernel the CPU supports is
+picked on the first call.
+*/
+size_t partition_rows(double **rows, size_t n, int feature, double value, double **left, double **right);
+
+/*
+Name of the kernel used by 'partition_rows': "avx512", "avx2" or "scalar".
+*/
+const char *partition_kernel_name(void);
+
+#endif // partition_h
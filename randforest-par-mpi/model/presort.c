@@ -0,0 +1,122 @@
+/*
+Per-feature sort order of the training rows of a fold.
+*/
+
+#include <stdio.h>
+#include "presort.h"
+
+/*
+A feature value and the index of its row.
+*/
+typedef struct SortKey
+{
+    double value;
+    uint32_t row;
+} SortKey;
+
+static int compare_sort_keys(const void *a, const void *b)
+{
+    const SortKey *x = a;
+    const SortKey *y = b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/*
+Allocates the shared window of 'presort' (whose 'rows' and 'n_features' are set) and returns its
+lists, writable until 'publish_presort'.
+*/
+static uint32_t *alloc_presort(Presort *presort, int *node_rank, int *node_size)
+{
+    if (presort->rows > UINT32_MAX)
+    {
+        printf("Error: presorted training supports at most %u rows, got: %zu\n", UINT32_MAX, presort->rows);
+        exit(1);
+    }
+
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &presort->node_comm);
+    MPI_Comm_rank(presort->node_comm, node_rank);
+    MPI_Comm_size(presort->node_comm, node_size);
+
+    // The first rank of the host allocates the whole window, the others map it.
+    MPI_Aint bytes = *node_rank == 0 ? (MPI_Aint)(presort->n_features * presort->rows * sizeof(uint32_t)) : 0;
+    uint32_t *order;
+    MPI_Win_allocate_shared(bytes, sizeof(uint32_t), MPI_INFO_NULL, presort->node_comm, &order, &presort->win);
+
+    MPI_Aint size;
+    int disp_unit;
+    MPI_Win_shared_query(presort->win, 0, &size, &disp_unit, &order);
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, presort->win);
+    return order;
+}
+
+/*
+Makes the lists written by every rank of the host visible to all of them.
+*/
+static void publish_presort(Presort *presort, const uint32_t *order)
+{
+    MPI_Win_sync(presort->win);
+    MPI_Barrier(presort->node_comm);
+    MPI_Win_sync(presort->win);
+    MPI_Win_unlock_all(presort->win);
+    presort->order = order;
+}
+
+Presort presort_create(double **data, size_t rows, size_t cols)
+{
+    Presort presort = {.rows = rows, .n_features = cols - 1};
+    int node_rank, node_size;
+    uint32_t *order = alloc_presort(&presort, &node_rank, &node_size);
+
+    // Features are sorted round robin by the ranks of the host.
+    SortKey *keys = malloc(rows * sizeof(SortKey) + 1);
+    for (size_t f = (size_t)node_rank; f < presort.n_features; f += (size_t)node_size)
+    {
+        for (size_t j = 0; j < rows; ++j)
+            keys[j] = (SortKey){data[j][f], (uint32_t)j};
+        qsort(keys, rows, sizeof(SortKey), compare_sort_keys);
+
+        uint32_t *list = order + f * rows;
+        for (size_t p = 0; p < rows; ++p)
+            list[p] = keys[p].row;
+    }
+    free(keys);
+
+    publish_presort(&presort, order);
+    return presort;
+}
+
+Presort presort_without_rows(const Presort *presort, size_t begin, size_t end)
+{
+    size_t removed = end - begin;
+    Presort filtered = {.rows = presort->rows - removed, .n_features = presort->n_features};
+    int node_rank, node_size;
+    uint32_t *order = alloc_presort(&filtered, &node_rank, &node_size);
+
+    // Dropping rows keeps every list sorted, and shifting the later rows down keeps ties in order.
+    for (size_t f = (size_t)node_rank; f < filtered.n_features; f += (size_t)node_size)
+    {
+        const uint32_t *list = presort->order + f * presort->rows;
+        uint32_t *out = order + f * filtered.rows;
+        for (size_t p = 0; p < presort->rows; ++p)
+        {
+            uint32_t row = list[p];
+            if (row < begin)
+                *out++ = row;
+            else if (row >= end)
+                *out++ = row - (uint32_t)removed;
+        }
+    }
+
+    publish_presort(&filtered, order);
+    return filtered;
+}
+
+void free_presort(Presort *presort)
+{
+    MPI_Win_free(&presort->win);
+    MPI_Comm_free(&presort->node_comm);
+    presort->order = NULL;
+}
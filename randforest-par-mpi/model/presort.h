@@ -0,0 +1,49 @@
+/*
+Per-feature sort order of the rows of a dataset, computed once and shared by every tree, so that the
+split search never sorts the rows of a node (SLIQ/SPRINT style). The order of each cross validation
+fold's training rows is filtered from the order of all rows.
+*/
+
+#ifndef presort_h
+#define presort_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+/*
+Read-only sort order of 'rows' rows. The lists live in an MPI shared memory window, so all ranks on
+the same host map one copy of them.
+*/
+struct Presort
+{
+    size_t rows;
+    size_t n_features;     // Every column except the target.
+    const uint32_t *order; // 'n_features' lists of 'rows' row indices, feature 'f' starting at
+                           // 'f * rows', each sorted by the feature's value with ties by index.
+    MPI_Win win;
+    MPI_Comm node_comm;    // Ranks sharing 'win'.
+};
+
+typedef struct Presort Presort;
+
+/*
+Sorts the 'rows' rows of 'data' by every one of its 'cols - 1' features. The ranks of each host
+sort a share of the features each into one shared window. Collective over MPI_COMM_WORLD, and every
+rank must pass the same rows. Exits if there are more rows than a uint32_t index can address.
+*/
+Presort presort_create(double **data, size_t rows, size_t cols);
+
+/*
+Derives the presort of the rows left after removing rows [begin, end) from 'presort' with one
+linear filter per feature, without sorting again. Rows from 'end' on move down by 'end - begin'.
+Collective over MPI_COMM_WORLD.
+*/
+Presort presort_without_rows(const Presort *presort, size_t begin, size_t end);
+
+/*
+Frees the window of a presort made by 'presort_create'. Collective over MPI_COMM_WORLD.
+*/
+void free_presort(Presort *presort);
+
+#endif // presort_h
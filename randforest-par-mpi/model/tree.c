@@ -5,17 +5,139 @@
 @author andrii dobroshynski
 */
 
+#include <stddef.h>
 #include "tree.h"
+#include "partition.h"
+#include "../utils/timer.h"
+#include "../utils/perf.h"
 //#include "../utils/log.h" rufino@ipb.pt
 
 /*
-Allocates memory for an empty DecisionTreeNode and returns a pointer to the node.
+Ranks that share the split search of every node of the trees built by this rank, and this rank's
+position in them. The rank and size are read once here, on the main thread, as the builders may run
+on worker threads that must not call MPI.
 */
-DecisionTreeNode *empty_node(long *id)
+static MPI_Comm split_comm = MPI_COMM_SELF;
+static int split_rank = 0;
+static int split_size = 1;
+
+void set_split_comm(MPI_Comm comm)
+{
+    split_comm = comm;
+    MPI_Comm_rank(split_comm, &split_rank);
+    MPI_Comm_size(split_comm, &split_size);
+}
+
+/*
+Worker threads that subtrees of at least 'subtree_cutoff' rows are handed to (see 'set_subtree_pool').
+*/
+static ThreadPool *subtree_pool = NULL;
+static size_t subtree_cutoff = 0;
+
+void set_subtree_pool(ThreadPool *pool, size_t cutoff)
+{
+    subtree_pool = pool;
+    subtree_cutoff = cutoff;
+}
+
+void node_arena_init(NodeArena *arena)
+{
+    arena->next_id = 0;
+    arena->first = NULL;
+    arena->last = NULL;
+    pthread_mutex_init(&arena->lock, NULL);
+    arena->stats = (TreeStats){0};
+}
+
+void node_arena_finish(NodeArena *arena)
+{
+    pthread_mutex_destroy(&arena->lock);
+}
+
+/*
+Takes the next node of 'arena' and its ID, chaining a new chunk when the last one is full.
+*/
+static DecisionTreeNode *arena_take_node(NodeArena *arena, long *id)
+{
+    pthread_mutex_lock(&arena->lock);
+
+    NodeChunk *chunk = arena->last;
+    if (chunk == NULL || chunk->used == chunk->capacity)
+    {
+        size_t capacity = chunk == NULL ? NODE_CHUNK_MIN : 2 * chunk->capacity;
+        if (capacity > NODE_CHUNK_MAX)
+            capacity = NODE_CHUNK_MAX;
+
+        NodeChunk *fresh = malloc(sizeof(NodeChunk) + capacity * sizeof(DecisionTreeNode));
+        if (fresh == NULL)
+        {
+            printf("Error: failed to allocate a chunk of %zu tree nodes\n", capacity);
+            exit(-1);
+        }
+        fresh->next = NULL;
+        fresh->used = 0;
+        fresh->capacity = capacity;
+        __sync_fetch_and_add(&arena->stats.bytes, (long)(sizeof(NodeChunk) + capacity * sizeof(DecisionTreeNode)));
+
+        if (chunk == NULL)
+            arena->first = fresh;
+        else
+            chunk->next = fresh;
+        arena->last = chunk = fresh;
+    }
+    DecisionTreeNode *node = &chunk->nodes[chunk->used++];
+    *id = arena->next_id++;
+
+    pthread_mutex_unlock(&arena->lock);
+    return node;
+}
+
+void tree_stats_add(TreeStats *stats, const TreeStats *delta)
+{
+    __sync_fetch_and_add(&stats->candidates, delta->candidates);
+    __sync_fetch_and_add(&stats->rows_scanned, delta->rows_scanned);
+    __sync_fetch_and_add(&stats->rows_partitioned, delta->rows_partitioned);
+    __sync_fetch_and_add(&stats->bytes, delta->bytes);
+    __sync_fetch_and_add(&stats->nodes, delta->nodes);
+    __sync_fetch_and_add(&stats->leaves, delta->leaves);
+
+    long depth = stats->max_depth;
+    while (delta->max_depth > depth)
+        depth = __sync_val_compare_and_swap(&stats->max_depth, depth, delta->max_depth);
+}
+
+/*
+Depth of the deepest leaf below 'node', which is at depth 'depth'.
+*/
+static long tree_depth(const DecisionTreeNode *node, long depth)
+{
+    long left = node->leftChild ? tree_depth(node->leftChild, depth + 1) : depth + 1;
+    long right = node->rightChild ? tree_depth(node->rightChild, depth + 1) : depth + 1;
+    return left > right ? left : right;
+}
+
+static long count_nodes(const DecisionTreeNode *node)
+{
+    return 1 + (node->leftChild ? count_nodes(node->leftChild) : 0) +
+           (node->rightChild ? count_nodes(node->rightChild) : 0);
+}
+
+void measure_tree(const DecisionTreeNode *root, TreeStats *stats)
+{
+    stats->nodes = count_nodes(root);
+    stats->leaves = stats->nodes + 1;
+    stats->max_depth = tree_depth(root, 0);
+}
+
+/*
+Allocates an empty DecisionTreeNode from 'arena' and returns a pointer to the node.
+*/
+DecisionTreeNode *empty_node(NodeArena *arena)
 {
-    DecisionTreeNode *node = malloc(sizeof(DecisionTreeNode));
+    long id;
+    DecisionTreeNode *node = arena_take_node(arena, &id);
 
-    node->id = (*id);
+    node->id = id;
     node->leftChild = NULL;
     node->rightChild = NULL;
 
@@ -28,7 +150,8 @@ DecisionTreeNode *empty_node(long *id)
     node->split_value = -1;
     node->split_data_halves = NULL;
 
-    (*id)++;
+    node->left_value = 0.0;
+    node->right_value = 0.0;
 
     log_if_level(2, "created a DecisionTreeNode with id %ld stored at address %p \n", node->id, node);
     
@@ -47,200 +170,131 @@ void populate_split_data(DecisionTreeNode *node, DecisionTreeDataSplit *data_spl
 }
 
 /*
-Given a two dimensional array of data finds and returns a DecisionTreeTargetClasses
-struct with unique target classes found in the dataset at column with index 'cols - 1'.
+Given a two dimensional array of data returns the leaf node class value for the given
+data. The leaf node class value is whichever class value that is the class target value for
+the majority of the rows in the data. Ties go to the larger class value.
 */
-DecisionTreeTargetClasses get_target_class_values(double **data, size_t rows, size_t cols, const ModelContext *ctx)
+int get_leaf_node_class_value(double **data, size_t rows, size_t cols, size_t n_classes)
 {
-
-    log_if_level(1, "generating class value set...\n");
-    
-    size_t count = 0;
-    int *target_class_values = malloc(count * sizeof(int));
-
+    long *counts = calloc(n_classes, sizeof(long));
     for (size_t i = 0; i < rows; ++i)
     {
-        // Skip rows that we are withholding from training for evaluation.
-        if (is_row_part_of_testing_fold(i, ctx))
+        int class_label = (int)data[i][cols - 1];
+        if (class_label < 0 || (size_t)class_label >= n_classes)
         {
-            log_if_level(1, "  skipping row %ld which is part of testing fold %ld\n", i, ctx->testingFoldIdx);
-            continue;
+            printf("Error: class target values must be in [0, %zu), got: %d\n", n_classes, class_label);
+            exit(1);
         }
+        counts[class_label]++;
+    }
 
-        int class_target = (int)data[i][cols - 1];
-        if (!contains_int(target_class_values, count, class_target))
-        {
-            log_if_level(1, "  adding %d \n", class_target);
-            count++;
-            int *temp = realloc(target_class_values, count * sizeof(int));
-            if (temp != NULL)
-                target_class_values = temp;
-            target_class_values[count - 1] = class_target;
-        }
+    size_t best = 0;
+    for (size_t c = 1; c < n_classes; ++c)
+    {
+        if (counts[c] >= counts[best])
+            best = c;
     }
-    log_if_level(1, "-------------------------------\ncount of unique classes: %ld\n", count);
-    return (DecisionTreeTargetClasses){count, target_class_values};
+    free(counts);
+    return (int)best;
 }
 
 /*
-Given a two dimensional array of data returns the leaf node class value for the given
-data. The leaf node class value is whichever class value that is the class target value for
-the majority of the rows in the data.
+Mean target value of the 'rows' rows of 'data', or 'fallback' if there are none.
 */
-int get_leaf_node_class_value(double **data, size_t rows, size_t cols)
+static double get_leaf_node_mean(double **data, size_t rows, size_t cols, double fallback)
 {
-    int zeroes = 0;
-    int ones = 0;
+    if (rows == 0)
+        return fallback;
+    double sum = 0.0;
     for (size_t i = 0; i < rows; ++i)
+        sum += data[i][cols - 1];
+    return sum / (double)rows;
+}
+
+/*
+Makes side 'side' (0 left, 1 right) of 'node' a leaf predicting the majority class or, for
+regression, the mean target of its 'rows' rows in 'data'. An empty regression side predicts
+'fallback', the mean of the node.
+*/
+static void set_leaf(DecisionTreeNode *node,
+                     int side,
+                     double **data,
+                     size_t rows,
+                     size_t cols,
+                     const ModelContext *ctx,
+                     double fallback)
+{
+    if (ctx->regression)
     {
-        int class_label = (int)data[i][cols - 1];
-        if (class_label == 0)
-            zeroes++;
-        else if (class_label == 1)
-            ones++;
+        double value = get_leaf_node_mean(data, rows, cols, fallback);
+        if (side == 0)
+            node->left_value = value;
         else
-        {
-            printf("Error: currently only support binary classification, i.e. class target values 0/1, got: %d\n",
-                   class_label);
-            exit(1);
-        }
+            node->right_value = value;
     }
-    if (ones >= zeroes)
-        return 1;
     else
-        return 0;
+    {
+        int leaf = get_leaf_node_class_value(data, rows, cols, ctx->n_classes);
+        if (side == 0)
+            node->left_leaf = leaf;
+        else
+            node->right_leaf = leaf;
+    }
 }
 
 /*
-Given a two dimensional array of data and parameters for a split, splits the data into two halves and
-returns a pointer to an array of two DecisionTreeData for the two halves of the split.
+Shrinks a buffer of row pointers to 'count' rows, keeping the buffer if 'realloc' fails.
 */
+static double **shrink_rows(double **buffer, size_t count)
+{
+    double **shrunk = realloc(buffer, count * sizeof(double *) + 1);
+    return shrunk ? shrunk : buffer;
+}
+
 DecisionTreeData *split_dataset(int feature_index,
                                 double value,
                                 double **data,
                                 size_t rows,
                                 size_t cols)
 {
-    log_if_level(1, "splitting dataset into two halves...\n");
+    log_if_level(2, "splitting dataset into two halves...\n");
 
-    // Buffers to hold rows of data as we are distributing rows based on the split.
-    
-    size_t left_count = 0;
-    size_t right_count = 0;
-    
-    for (size_t i = 0; i < rows; ++i) {
-    
-        double *row = data[i];
-        
-        if (row[feature_index] < value)
-          ++left_count;
-          
-        else 
-          ++right_count;
-          
-    }
-    
-    double **left = (double **)malloc(left_count * sizeof(double *));
-    double **right = (double **)malloc(right_count * sizeof(double *));
+    // Either half may receive every row until the partition is done, then gets shrunk to its size.
+    // Empty halves keep a valid allocation, as 'grow' treats a NULL half as a leaf.
+    double **left = (double **)malloc(rows * sizeof(double *) + 1);
+    double **right = (double **)malloc(rows * sizeof(double *) + 1);
 
+    size_t left_count = partition_rows(data, rows, feature_index, value, left, right);
+    size_t right_count = rows - left_count;
+
+    left = shrink_rows(left, left_count);
+    right = shrink_rows(right, right_count);
 
-    left_count = 0, right_count = 0;
-    for (size_t i = 0; i < rows; ++i)
-    {
-        double *row = data[i];
-        if (row[feature_index] < value)
-        {
-        
-            // Copy the row into the left half and resize the buffer.
-            left[left_count++] = row;
-            // double **temp = realloc(left, left_count * sizeof(double) * cols); Redução de tempo
-        
-        }
-        else
-        {
-            // Copy the row into the right half and resize the buffer.
-            right[right_count++] = row;        
-            // double **temp = realloc(right, right_count * sizeof(double) * cols); Redução de tempo
-        }
-    }
     DecisionTreeData *data_split = malloc(sizeof(DecisionTreeData) * 2);
-    data_split[0] = (DecisionTreeData){left_count, left};
-    data_split[1] = (DecisionTreeData){right_count, right};
+    data_split[0] = (DecisionTreeData){left_count, left, NULL};
+    data_split[1] = (DecisionTreeData){right_count, right, NULL};
 
-    log_if_level(1, "split dataset into: %ld | %ld\n", left_count, right_count);
+    log_if_level(2, "split dataset into: %ld | %ld\n", left_count, right_count);
 
     return data_split;
 }
 
-double calculate_gini_index(DecisionTreeData *data_split,
-                            int *class_labels,
-                            size_t class_labels_count,
-                            size_t cols)
+double gini_from_counts(const long *counts, size_t n_classes, size_t n)
 {
-    log_if_level(1, "calculating gini index based on split...\n");
-
-    // DecisionTreeData data split should consist of two halves.
-    //rufino@ipb.pt: changed int to size_t to avoid
-    //warning: comparison of integer expressions of different signedness: ‘size_t’ {aka ‘long unsigned int’} and ‘int’
-    //int count = 2;
-    size_t count = 2;
-    size_t n_instances = data_split[0].length + data_split[1].length;
-    double gini = 0.0;
-    for (size_t i = 0; i < count; ++i)
+    if (n == 0)
+        return 0.0;
+    double sum = 0.0;
+    for (size_t c = 0; c < n_classes; ++c)
     {
-        DecisionTreeData group = data_split[i];
-
-        size_t size = group.length;
-        if (size == 0)
-            continue;
-
-        double sum = 0.0;
-        for (size_t j = 0; j < class_labels_count; ++j)
-        {
-            int class = class_labels[j];
-            int occurences = 0;
-            for (size_t k = 0; k < size; ++k)
-            {
-                int label = (int)group.data[k][cols - 1];
-                if (label == class)
-                    occurences += 1;
-            }
-            double p_class = (double)occurences / (double)size;
-            sum += (p_class * p_class);
-        }
-        gini += (1.0 - sum) * ((double)size / (double)n_instances);
+        double p_class = (double)counts[c] / (double)n;
+        sum += p_class * p_class;
     }
-
-    log_if_level(1, "gini: %f\n", gini);
-    log_if_level(1, "-----------------------------------------\n");
-
-    return gini;
+    return 1.0 - sum;
 }
 
-DecisionTreeDataSplit calculate_best_data_split(double **data,
-                                                size_t max_features,
-                                                size_t rows,
-                                                size_t cols,
-                                                const ModelContext *ctx)
+void sample_features(int *features, size_t max_features, size_t cols, RandomState *rng)
 {
-    if (log_level > 1)
-    {
-        printf("calculating best split for dataset...\n");
-        printf("rows: %ld\ncols: %ld\n", rows, cols);
-    }
-
-    // Target classes available in this dataset.
-    DecisionTreeTargetClasses classes = get_target_class_values(data, rows, cols, ctx);
-
-    // Keeping track of best data split available along with best parameters associated with
-    // that data split.
-    DecisionTreeData *best_data_split = NULL;
-    double best_value = DBL_MAX;
-    double best_gini = DBL_MAX;
-    int best_index = INT_MAX;
-
-    // Create a features array and initialize to avoid non-set memory.
-    int *features = malloc(max_features * sizeof(int));
+    // Initialize to avoid non-set memory.
     for (size_t i = 0; i < max_features; ++i)
         features[i] = -1;
 
@@ -251,204 +305,1440 @@ DecisionTreeDataSplit calculate_best_data_split(double **data,
         // which is 'cols - 1'.
         int max = cols - 2;
         int min = 0;
-        int index = rand() % (max + 1 - min) + min;
+        int index = rng_next(rng) % (max + 1 - min) + min;
         if (!contains_int(features, max_features /* size of 'features' array */, index))
         {
-            if (log_level > 1)
-                printf("adding unique index: %d\n", index);
+            log_if_level(2, "adding unique index: %d\n", index);
             features[count++] = index;
         }
     }
-    if (log_level > 1)
-        printf("-----------------------------------------\n");
+    log_if_level(2, "-----------------------------------------\n");
+}
 
-    for (size_t i = 0; i < max_features; ++i)
-    {
-        int feature_index = features[i];
-        for (size_t j = 0; j < rows; ++j)
-        {
-            DecisionTreeData *data_split = split_dataset(feature_index,
-                                                         data[j][feature_index],
-                                                         data,
-                                                         rows,
-                                                         cols);
-            double gini = calculate_gini_index(data_split, classes.labels, classes.count, cols);
-
-            if (gini < best_gini)
-            {
-                best_index = feature_index;
-                best_value = data[j][feature_index];
-                best_gini = gini;
+/*
+Packs the binary class targets of 'data' into the 'rows / 64 + 1' words of 'bits', bit 'i % 64' of
+word 'i / 64' holding the label of row 'i'.
+*/
+static void pack_binary_labels(double **data, size_t rows, size_t cols, uint64_t *bits)
+{
+    memset(bits, 0, (rows / 64 + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < rows; ++i)
+        bits[i / 64] |= (uint64_t)(data[i][cols - 1] == 1.0) << (i % 64);
+}
 
-                // First free the memory that was previously allocated for the 'data_split' and pointer
-                // which was assigned to 'best_data_split' since now we have found a new better split.
-                if (best_data_split)
-                    free_decision_tree_data(best_data_split);
+#if defined(__GNUC__) && defined(__x86_64__)
+#define POPCOUNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define POPCOUNT_CLONES
+#endif
 
-                best_data_split = data_split;
-            }
-            else
-            {
-                free_decision_tree_data(data_split);
-            }
-        }
-    }
+/*
+Counts the 'values' below 'threshold' into 'n_left', and how many of those rows have label 1 in
+'labels' into 'ones_left'. Each 64 rows become one comparison bitmask, counted with popcount.
+*/
+POPCOUNT_CLONES static void count_binary_left(const double *values,
+                                              size_t rows,
+                                              double threshold,
+                                              const uint64_t *labels,
+                                              size_t *n_left,
+                                              size_t *ones_left)
+{
+    size_t left = 0, ones = 0;
+    for (size_t w = 0; w * 64 < rows; ++w)
+    {
+        size_t end = rows - w * 64 < 64 ? rows - w * 64 : 64;
+        const double *block = values + w * 64;
 
-    // Free any other memory.
-    free(features);
-    free(classes.labels);
+        uint64_t mask = 0;
+        for (size_t b = 0; b < end; ++b)
+            mask |= (uint64_t)(block[b] < threshold) << b;
 
-    return (DecisionTreeDataSplit){best_index, best_value, best_gini, best_data_split};
+        left += __builtin_popcountll(mask);
+        ones += __builtin_popcountll(mask & labels[w]);
+    }
+    *n_left = left;
+    *ones_left = ones;
 }
 
-void grow(DecisionTreeNode *decision_tree,
-          size_t max_depth,
-          size_t min_samples_leaf,
-          size_t max_features,
-          //rufino@ip.pt: to avoid the following warning when comparing with max_depth
-          //warning: comparison of integer expressions of different signedness: ‘int’ and ‘size_t’ {aka ‘long unsigned int’}
-          //int depth,
-          size_t depth,
-          size_t rows,
-          size_t cols,
-          long *nodeId,
-          const ModelContext *ctx)
+/*
+Gini index of splitting 'n' rows, 'ones' of which have label 1, into 'n_left' rows holding 'ones_left'
+ones and the rest. Equals 'gini_from_counts' of the two classes, so binary and other nodes are
+scored alike.
+*/
+static double binary_gini(size_t n_left, size_t ones_left, size_t n, size_t ones)
 {
-    DecisionTreeData left_half = decision_tree->split_data_halves[0];
-    DecisionTreeData right_half = decision_tree->split_data_halves[1];
-
-    double **left = left_half.data;
-    double **right = right_half.data;
+    size_t size[2] = {n_left, n - n_left};
+    size_t class_ones[2] = {ones_left, ones - ones_left};
 
-    decision_tree->split_data_halves = NULL;
-
-    if (left == NULL || right == NULL)
+    double gini = 0.0;
+    for (int side = 0; side < 2; ++side)
     {
-        // If we are at the leaf node, then combine both left and right side data and compute get the leaf
-        // node class for the combined data.
-        double **combined_data = combine_arrays(left, right, left_half.length, right_half.length, cols);
-        int leaf = get_leaf_node_class_value(combined_data, rows, cols);
+        if (size[side] == 0)
+            continue;
 
-        decision_tree->left_leaf = leaf;
-        decision_tree->right_leaf = leaf;
+        double p_one = (double)class_ones[side] / (double)size[side];
+        double p_zero = (double)(size[side] - class_ones[side]) / (double)size[side];
+        gini += (1.0 - (p_zero * p_zero + p_one * p_one)) * ((double)size[side] / (double)n);
+    }
+    return gini;
+}
 
-        free(left);
-        free(right);
-        free(combined_data);
+/*
+A feature value of a row and the row's target, sorted by value so that the candidate thresholds of
+the feature can be swept in order.
+*/
+typedef struct SortedTarget
+{
+    double value;
+    double target;
+    size_t row;
+} SortedTarget;
 
-        return;
-    }
-    if (depth >= max_depth)
-    {
-        decision_tree->left_leaf = get_leaf_node_class_value(left, left_half.length /* rows */, cols);
-        decision_tree->right_leaf = get_leaf_node_class_value(right, right_half.length /* rows */, cols);
+static int compare_sorted_targets(const void *a, const void *b)
+{
+    const SortedTarget *x = a;
+    const SortedTarget *y = b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
 
-        free(left);
-        free(right);
+/*
+Sorts the 'rows' rows of 'data' by the value of feature 'feature_index' into 'sorted', ties by row.
+*/
+static void sort_feature(double **data, size_t rows, size_t cols, int feature_index, SortedTarget *sorted)
+{
+    for (size_t j = 0; j < rows; ++j)
+        sorted[j] = (SortedTarget){data[j][feature_index], data[j][cols - 1], j};
+    qsort(sorted, rows, sizeof(SortedTarget), compare_sorted_targets);
+}
 
-        return;
-    }
-    if (left_half.length <= min_samples_leaf)
+/*
+Fills 'sorted' from the presorted indices 'list' of the 'rows' rows of 'data' for feature
+'feature_index', giving the same order as 'sort_feature' without sorting.
+*/
+static void gather_feature(double **data, const uint32_t *list, size_t rows, size_t cols, int feature_index, SortedTarget *sorted)
+{
+    for (size_t p = 0; p < rows; ++p)
     {
-        decision_tree->left_leaf = get_leaf_node_class_value(left, left_half.length /* rows */, cols);
+        size_t j = list[p];
+        sorted[p] = (SortedTarget){data[j][feature_index], data[j][cols - 1], j};
     }
-    else
-    {
-        DecisionTreeDataSplit data_split = calculate_best_data_split(left,
-                                                                     max_features,
-                                                                     left_half.length /* rows */,
-                                                                     cols,
-                                                                     ctx);
+}
 
-        // Create the left child of the current node and populate with data from the data split.
-        decision_tree->leftChild = empty_node(nodeId);
-        populate_split_data(decision_tree->leftChild, &data_split);
+/*
+Splits the presorted 'order' of a node of 'rows' rows between the 'halves' made by 'split_dataset'
+for its split on 'feature_index' at 'value'. Every list is filtered in order, so each half's lists
+stay sorted, and the indices are renumbered to the rows of the half, which 'split_dataset' keeps in
+the node's order. 'side' and 'renumbered' are scratch space for 'rows' entries.
+*/
+static void split_order(const uint32_t *order,
+                        double **data,
+                        size_t rows,
+                        size_t cols,
+                        int feature_index,
+                        double value,
+                        DecisionTreeData *halves,
+                        unsigned char *side,
+                        uint32_t *renumbered)
+{
+    size_t n_features = cols - 1;
+    size_t count[2] = {0, 0};
+    for (size_t j = 0; j < rows; ++j)
+    {
+        side[j] = !(data[j][feature_index] < value);
+        renumbered[j] = (uint32_t)count[side[j]]++;
+    }
 
-        grow(decision_tree->leftChild,
-             max_depth,
-             min_samples_leaf,
-             max_features,
-             depth + 1 /* since we are now at the next 'level' in the tree */,
-             rows,
-             cols,
-             nodeId,
-             ctx);
+    for (int s = 0; s < 2; ++s)
+        halves[s].order = malloc(n_features * count[s] * sizeof(uint32_t) + 1);
 
-        free(data_split.data);
-    }
-    if (right_half.length <= min_samples_leaf)
+    for (size_t f = 0; f < n_features; ++f)
     {
-        decision_tree->right_leaf = get_leaf_node_class_value(right, right_half.length, cols);
+        const uint32_t *list = order + f * rows;
+        uint32_t *out[2] = {halves[0].order + f * count[0], halves[1].order + f * count[1]};
+        for (size_t p = 0; p < rows; ++p)
+        {
+            size_t j = list[p];
+            *out[side[j]]++ = renumbered[j];
+        }
     }
-    else
-    {
-        DecisionTreeDataSplit data_split = calculate_best_data_split(right,
-                                                                     max_features,
-                                                                     right_half.length /* rows */,
-                                                                     cols,
-                                                                     ctx);
+}
 
-        // Create the right child of the current node and populate with data from the data split.
-        decision_tree->rightChild = empty_node(nodeId);
-        populate_split_data(decision_tree->rightChild, &data_split);
+/*
+Position of the first of the 'n_quantiles' evenly spaced quantiles 'k * rows / n_quantiles' of a
+sorted node of 'rows' rows that is >= 'p', or 'rows' if there is none.
+*/
+static size_t quantile_at_or_after(size_t p, size_t rows, size_t n_quantiles)
+{
+    size_t k = (p * n_quantiles + rows - 1) / rows;
+    return k < n_quantiles ? k * rows / n_quantiles : rows;
+}
 
-        grow(decision_tree->rightChild,
-             max_depth,
-             min_samples_leaf,
-             max_features,
-             depth + 1 /* since we are now at the next 'level' in the tree */,
-             rows,
-             cols,
-             nodeId,
-             ctx);
+/*
+Number of quantile candidates per feature of a node of 'rows' rows, 0 to try every distinct value.
+*/
+static size_t node_quantiles(size_t rows, const ModelContext *ctx)
+{
+    return ctx->quantile_rows > 0 && rows > ctx->quantile_rows ? ctx->n_quantiles : 0;
+}
 
-        free(data_split.data);
-    }
+/*
+Best split found so far by a split search. Candidates are ranked by their position 'order' =
+'i * rows + j' in the serial search order, 'i' being the feature's position in the sample and 'j'
+the row the threshold is taken from, and ties resolve to the first of them.
+*/
+typedef struct SplitCandidate
+{
+    int index;
+    double value;
+    double score;
+    size_t order;
+} SplitCandidate;
 
-    free(left);
-    free(right);
+static void consider_split(SplitCandidate *best, int index, double value, double score, size_t order)
+{
+    if (score < best->score || (score == best->score && order < best->order))
+        *best = (SplitCandidate){index, value, score, order};
 }
 
-void make_prediction(const DecisionTreeNode *decision_tree, double *row, int *prediction_val)
+/*
+Targets of the rows of a node, summarized once for every candidate of its split search.
+*/
+typedef struct NodeTargets
 {
-    if (row[decision_tree->split_index] < decision_tree->split_value)
+    double sum;           // Regression: sum of the targets,
+    double sum_sq;        // and of their squares.
+    int binary;           // Only classes 0 and 1 occur, scored with 'binary_gini' from
+    size_t ones;          // the rows of class 1.
+    uint64_t *label_bits; // ExtraTrees on binary classes: labels packed by 'pack_binary_labels'.
+    long *counts;         // Any number of classes: rows of each of the 'n_classes' classes,
+    long *left;           // and the class counts of both halves of a candidate.
+    long *right;
+    size_t n_classes;
+} NodeTargets;
+
+/*
+Summarizes the targets of the 'rows' rows of 'data'. 'class_counts' holds the '3 * ctx->n_classes'
+counts of the node and of both halves. With ExtraTrees, binary labels also get packed into the
+'rows / 64 + 1' words of 'bits', which its single pass per feature counts with popcount; the sorted
+sweep only needs the running count of ones, so the other builders don't pack.
+*/
+static NodeTargets fill_node_targets(double **data,
+                                     size_t rows,
+                                     size_t cols,
+                                     const ModelContext *ctx,
+                                     uint64_t *bits,
+                                     long *class_counts)
+{
+    NodeTargets t = {0};
+    if (ctx->regression)
     {
-        if (decision_tree->leftChild != NULL)
-            make_prediction(decision_tree->leftChild, row, prediction_val);
-        else
-            (*prediction_val) = decision_tree->left_leaf;
+        for (size_t j = 0; j < rows; ++j)
+        {
+            t.sum += data[j][cols - 1];
+            t.sum_sq += data[j][cols - 1] * data[j][cols - 1];
+        }
+        return t;
     }
-    else
+
+    t.n_classes = ctx->n_classes;
+    t.counts = class_counts;
+    t.left = class_counts + ctx->n_classes;
+    t.right = class_counts + 2 * ctx->n_classes;
+    memset(t.counts, 0, ctx->n_classes * sizeof(long));
+    for (size_t j = 0; j < rows; ++j)
+        t.counts[(int)data[j][cols - 1]]++;
+
+    t.binary = 1;
+    for (size_t c = 2; c < t.n_classes; ++c)
+        t.binary = t.binary && t.counts[c] == 0;
+    t.ones = t.n_classes > 1 ? (size_t)t.counts[1] : 0;
+    if (t.binary && bits)
     {
-        if (decision_tree->rightChild != NULL)
-            make_prediction(decision_tree->rightChild, row, prediction_val);
-        else
-            (*prediction_val) = decision_tree->right_leaf;
+        pack_binary_labels(data, rows, cols, bits);
+        t.label_bits = bits;
     }
+    return t;
 }
 
 /*
-Frees memory for a given DecisionTreeNode.
+Summarizes the targets like 'fill_node_targets' into buffers of its own, released by
+'free_node_targets'.
 */
-void free_decision_tree_node(const DecisionTreeNode *node, long *freeCount)
+static NodeTargets summarize_targets(double **data,
+                                     size_t rows,
+                                     size_t cols,
+                                     const ModelContext *ctx)
 {
-    (*freeCount)++;
-    if (node->leftChild)
-        free_decision_tree_node(node->leftChild, freeCount);
-    if (node->rightChild)
-        free_decision_tree_node(node->rightChild, freeCount);
+    if (ctx->regression)
+        return fill_node_targets(data, rows, cols, ctx, NULL, NULL);
 
-    if (log_level > 2)
-        printf("freeing DecisionTreeNode with id=%ld\n", node->id);
+    uint64_t *bits = ctx->extra_trees ? malloc((rows / 64 + 1) * sizeof(uint64_t)) : NULL;
+    long *class_counts = malloc(3 * ctx->n_classes * sizeof(long) + 1);
+    NodeTargets t = fill_node_targets(data, rows, cols, ctx, bits, class_counts);
+    if (t.label_bits == NULL)
+        free(bits);
+    return t;
+}
 
-    if (node && node->split_data_halves && node->split_data_halves->length)
-    {
-        free(node->split_data_halves[0].data);
-        free(node->split_data_halves[1].data);
-        free(node->split_data_halves);
-    }
+static void free_node_targets(NodeTargets *t)
+{
+    free(t->label_bits);
+    free(t->counts);
+}
+
+/*
+Sum of squared deviations from the mean of 'n' targets with sum 'sum' and sum of squares 'sum_sq'.
+*/
+static double sum_squared_error(size_t n, double sum, double sum_sq)
+{
+    if (n == 0)
+        return 0.0;
+    double sse = sum_sq - sum * sum / (double)n;
+    return sse > 0.0 ? sse : 0.0;
+}
 
-    free((void *)node);
+/*
+Weighted variance of the targets of both halves of a node of 'rows' rows, the left one holding
+'n_left' rows with sum 'left_sum' and sum of squares 'left_sum_sq'. The 'gini' of regression splits.
+*/
+static double variance_score(size_t n_left, double left_sum, double left_sum_sq, size_t rows, const NodeTargets *t)
+{
+    return (sum_squared_error(n_left, left_sum, left_sum_sq) +
+            sum_squared_error(rows - n_left, t->sum - left_sum, t->sum_sq - left_sum_sq)) /
+           (double)rows;
+}
+
+/*
+Gini index of a split of a node of 'rows' rows whose left half holds 'n_left' rows with class counts
+'t->left', for any number of classes.
+*/
+static double class_gini(size_t n_left, size_t rows, const NodeTargets *t)
+{
+    for (size_t c = 0; c < t->n_classes; ++c)
+        t->right[c] = t->counts[c] - t->left[c];
+
+    size_t n_right = rows - n_left;
+    return gini_from_counts(t->left, t->n_classes, n_left) * ((double)n_left / (double)rows) +
+           gini_from_counts(t->right, t->n_classes, n_right) * ((double)n_right / (double)rows);
+}
+
+/*
+Running state of the sweep of one feature over the rows of a node in value order. Rows with equal
+values give the same split, so each distinct value is a candidate once, at the first of its rows,
+with the rows before it going to the left. With quantiles, a run of equal values is only tried if
+one of the quantiles falls inside it, which is only known once the run ends.
+*/
+typedef struct Sweep
+{
+    size_t p;           // Rows swept so far.
+    double left_sum;    // Regression: running sums of y and y^2 of the rows swept,
+    double left_sum_sq;
+    size_t ones_left;   // binary classes: running count of class 1 (any number of classes
+                        // are counted in 'NodeTargets.left').
+    size_t run_start;   // First row of the current run of equal values,
+    SplitCandidate run; // and its candidate.
+    size_t candidates;  // Thresholds scored.
+} Sweep;
+
+static void sweep_begin(Sweep *s, const ModelContext *ctx, NodeTargets *t)
+{
+    *s = (Sweep){0};
+    if (!ctx->regression && !t->binary)
+        memset(t->left, 0, t->n_classes * sizeof(long));
+}
+
+/*
+Considers the candidate of the run of equal values that just ended.
+*/
+static void sweep_close_run(Sweep *s, size_t rows, size_t n_quantiles, SplitCandidate *best)
+{
+    if (n_quantiles == 0 || quantile_at_or_after(s->run_start, rows, n_quantiles) < s->p)
+        consider_split(best, s->run.index, s->run.value, s->run.score, s->run.order);
+}
+
+/*
+Adds the next row of a node of 'rows' rows to the sweep of feature 'feature_index', the 'i'-th of
+the sample: its 'value', class or regression 'target' and index 'row' in the node.
+*/
+static void sweep_row(Sweep *s,
+                      double value,
+                      double target,
+                      size_t row,
+                      int feature_index,
+                      size_t i,
+                      size_t rows,
+                      size_t n_quantiles,
+                      const ModelContext *ctx,
+                      NodeTargets *t,
+                      SplitCandidate *best)
+{
+    if (s->p == 0 || value != s->run.value)
+    {
+        if (s->p > 0)
+            sweep_close_run(s, rows, n_quantiles, best);
+
+        // The rows swept so far are exactly those below the threshold 'value'.
+        double score;
+        if (ctx->regression)
+            score = variance_score(s->p, s->left_sum, s->left_sum_sq, rows, t);
+        else if (t->binary)
+            score = binary_gini(s->p, s->ones_left, rows, t->ones);
+        else
+            score = class_gini(s->p, rows, t);
+
+        s->run = (SplitCandidate){feature_index, value, score, i * rows + row};
+        s->run_start = s->p;
+        s->candidates++;
+    }
+
+    if (ctx->regression)
+    {
+        s->left_sum += target;
+        s->left_sum_sq += target * target;
+    }
+    else if (t->binary)
+        s->ones_left += target == 1.0;
+    else
+        t->left[(int)target]++;
+    s->p++;
+}
+
+static void sweep_end(Sweep *s, size_t rows, size_t n_quantiles, SplitCandidate *best)
+{
+    if (s->p > 0)
+        sweep_close_run(s, rows, n_quantiles, best);
+}
+
+/*
+Scores every candidate threshold of feature 'feature_index' in one sweep over its 'rows' values
+sorted into 'sorted', keeping running sums of y and y^2 (regression) or running class counts of the
+rows below the threshold, and updates 'best' if the feature has a better split. 'i' ranks the
+feature in the search order. Returns the number of thresholds scored.
+*/
+static size_t sweep_candidates(const SortedTarget *sorted,
+                             size_t rows,
+                             int feature_index,
+                             size_t i,
+                             size_t n_quantiles,
+                             const ModelContext *ctx,
+                             NodeTargets *t,
+                             SplitCandidate *best)
+{
+    Sweep s;
+    sweep_begin(&s, ctx, t);
+    for (size_t p = 0; p < rows; ++p)
+        sweep_row(&s, sorted[p].value, sorted[p].target, sorted[p].row, feature_index, i, rows, n_quantiles, ctx, t, best);
+    sweep_end(&s, rows, n_quantiles, best);
+    return s.candidates;
+}
+
+/*
+Draws the ExtraTrees threshold of feature 'feature_index': 'min + u * (max - min)' over the values of
+the node's rows, for 'u' in (0, 1]. At least one row is never below it, and at least one is whenever
+the feature is not constant in the node.
+*/
+static double random_threshold(double **data, size_t rows, int feature_index, double u)
+{
+    double min = data[0][feature_index];
+    double max = min;
+    for (size_t j = 1; j < rows; ++j)
+    {
+        double value = data[j][feature_index];
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    double threshold = min + u * (max - min);
+    return threshold > min && threshold <= max ? threshold : max;
+}
+
+/*
+Scores the single split of feature 'feature_index' at 'threshold' with one pass over the node's rows,
+as ExtraTrees does. 'values' holds 'rows' entries of scratch space.
+*/
+static double threshold_score(double **data,
+                              size_t rows,
+                              size_t cols,
+                              int feature_index,
+                              double threshold,
+                              const ModelContext *ctx,
+                              NodeTargets *t,
+                              double *values)
+{
+    if (t->label_bits)
+    {
+        // Compare the feature's values against the threshold 64 rows at a time and popcount the
+        // masks against the packed labels.
+        for (size_t j = 0; j < rows; ++j)
+            values[j] = data[j][feature_index];
+
+        size_t n_left, ones_left;
+        count_binary_left(values, rows, threshold, t->label_bits, &n_left, &ones_left);
+        return binary_gini(n_left, ones_left, rows, t->ones);
+    }
+
+    double left_sum = 0.0, left_sum_sq = 0.0;
+    size_t n_left = 0;
+    if (!ctx->regression)
+        memset(t->left, 0, t->n_classes * sizeof(long));
+    for (size_t j = 0; j < rows; ++j)
+    {
+        if (data[j][feature_index] < threshold)
+        {
+            double target = data[j][cols - 1];
+            if (ctx->regression)
+            {
+                left_sum += target;
+                left_sum_sq += target * target;
+            }
+            else
+                t->left[(int)target]++;
+            ++n_left;
+        }
+    }
+    return ctx->regression ? variance_score(n_left, left_sum, left_sum_sq, rows, t) : class_gini(n_left, rows, t);
+}
+
+/*
+Buffers of the split search, reused by every call of 'calculate_best_data_split' on the same thread
+instead of being allocated per node. Each one holds enough entries for the largest 'max_features',
+node and class count seen on the thread so far.
+*/
+typedef struct SplitScratch
+{
+    size_t max_features;
+    size_t rows;
+    size_t n_classes;
+
+    int *features;             // 'max_features' sampled features,
+    double *draws;             // and their ExtraTrees threshold draws.
+    long *class_counts;        // '3 * n_classes' class counts, see 'fill_node_targets'.
+    uint64_t *label_bits;      // 'rows / 64 + 1' words of packed binary labels.
+    SortedTarget *sorted;      // 'rows' entries each for the sorted sweep,
+    double *values;            // the ExtraTrees scoring pass,
+    unsigned char *side;       // and 'split_order'.
+    uint32_t *renumbered;
+} SplitScratch;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void free_split_scratch(void *arg)
+{
+    SplitScratch *s = arg;
+    free(s->features);
+    free(s->draws);
+    free(s->class_counts);
+    free(s->label_bits);
+    free(s->sorted);
+    free(s->values);
+    free(s->side);
+    free(s->renumbered);
+    free(s);
+}
+
+static void create_scratch_key(void)
+{
+    // Worker threads free their scratch when they exit.
+    pthread_key_create(&scratch_key, free_split_scratch);
+}
+
+/*
+Returns the split search buffers of the calling thread, growing them to hold a node of 'rows' rows,
+'max_features' sampled features and 'n_classes' classes.
+*/
+static SplitScratch *split_scratch(size_t max_features, size_t rows, size_t n_classes)
+{
+    pthread_once(&scratch_once, create_scratch_key);
+    SplitScratch *s = pthread_getspecific(scratch_key);
+    if (s == NULL)
+    {
+        s = calloc(1, sizeof(SplitScratch));
+        pthread_setspecific(scratch_key, s);
+    }
+
+    // The contents never outlive a call, so growing a buffer doesn't need to keep them.
+    if (s->features == NULL || max_features > s->max_features)
+    {
+        free(s->features);
+        free(s->draws);
+        s->features = malloc(max_features * sizeof(int) + 1);
+        s->draws = malloc(max_features * sizeof(double) + 1);
+        s->max_features = max_features;
+    }
+    if (s->sorted == NULL || rows > s->rows)
+    {
+        free(s->label_bits);
+        free(s->sorted);
+        free(s->values);
+        free(s->side);
+        free(s->renumbered);
+        s->label_bits = malloc((rows / 64 + 1) * sizeof(uint64_t));
+        s->sorted = malloc(rows * sizeof(SortedTarget) + 1);
+        s->values = malloc(rows * sizeof(double) + 1);
+        s->side = malloc(rows + 1);
+        s->renumbered = malloc(rows * sizeof(uint32_t) + 1);
+        s->rows = rows;
+    }
+    if (s->class_counts == NULL || n_classes > s->n_classes)
+    {
+        free(s->class_counts);
+        s->class_counts = malloc(3 * n_classes * sizeof(long) + 1);
+        s->n_classes = n_classes;
+    }
+
+    if (!s->features || !s->draws || !s->label_bits || !s->sorted || !s->values || !s->side ||
+        !s->renumbered || !s->class_counts)
+    {
+        printf("Error: failed to allocate split search buffers for %zu rows\n", rows);
+        exit(-1);
+    }
+    return s;
+}
+
+void reserve_split_scratch(size_t max_features, size_t rows, size_t n_classes)
+{
+    split_scratch(max_features, rows, n_classes);
+}
+
+void release_split_scratch(void)
+{
+    pthread_once(&scratch_once, create_scratch_key);
+    SplitScratch *s = pthread_getspecific(scratch_key);
+    if (s)
+    {
+        free_split_scratch(s);
+        pthread_setspecific(scratch_key, NULL);
+    }
+}
+
+DecisionTreeDataSplit calculate_best_data_split(double **data,
+                                                const uint32_t *order,
+                                                size_t max_features,
+                                                size_t rows,
+                                                size_t cols,
+                                                const ModelContext *ctx,
+                                                TreeStats *stats,
+                                                RandomState *rng)
+{
+    log_if_level(2, "calculating best split for dataset...\nrows: %ld\ncols: %ld\n", rows, cols);
+
+    PerfSample search_sample;
+    perf_begin(&search_sample);
+
+    SplitScratch *scratch = split_scratch(max_features, rows, ctx->n_classes);
+
+    // Keeping track of best data split available along with best parameters associated with
+    // that data split.
+    DecisionTreeData *best_data_split = NULL;
+    SplitCandidate best = {INT_MAX, DBL_MAX, DBL_MAX, SIZE_MAX};
+
+    // Pick the features considered for this split.
+    int *features = scratch->features;
+    sample_features(features, max_features, cols, rng);
+
+    // ExtraTrees: a single random threshold per feature. Every rank draws all of them, so the
+    // generators stay in step and any rank can recompute the winning threshold.
+    double *draws = scratch->draws;
+    if (ctx->extra_trees)
+    {
+        for (size_t i = 0; i < max_features; ++i)
+            draws[i] = ((double)rng_next(rng) + 1.0) / 4294967296.0;
+    }
+
+    // Every rank of 'split_comm' sampled the same features; each one only evaluates its share of
+    // them. Candidates are ranked by their position 'i * rows + j' in the serial search order so
+    // that ties resolve exactly as if one rank had evaluated them all.
+
+    NodeTargets targets = fill_node_targets(data, rows, cols, ctx, ctx->extra_trees ? scratch->label_bits : NULL,
+                                            scratch->class_counts);
+
+    // Each sampled feature is sorted once, or taken from the presort, and its distinct values (or
+    // quantiles of them in large nodes) are swept in order, so a node costs O(rows log rows) per
+    // feature (O(rows) presorted) rather than one pass over the rows per candidate.
+    size_t n_quantiles = node_quantiles(rows, ctx);
+    SortedTarget *sorted = scratch->sorted;
+    double *values = scratch->values;
+    TreeStats work = {0};
+    for (size_t i = split_rank; i < max_features; i += split_size)
+    {
+        int feature_index = features[i];
+        if (ctx->extra_trees)
+        {
+            // One pass for the range of the feature, one to score its threshold.
+            double threshold = random_threshold(data, rows, feature_index, draws[i]);
+            double score = threshold_score(data, rows, cols, feature_index, threshold, ctx, &targets, values);
+            consider_split(&best, feature_index, threshold, score, i * rows);
+            work.candidates++;
+            work.rows_scanned += 2 * (long)rows;
+            continue;
+        }
+
+        if (order)
+            gather_feature(data, order + (size_t)feature_index * rows, rows, cols, feature_index, sorted);
+        else
+            sort_feature(data, rows, cols, feature_index, sorted);
+        work.candidates += (long)sweep_candidates(sorted, rows, feature_index, i, n_quantiles, ctx, &targets, &best);
+        work.rows_scanned += (long)rows;
+    }
+
+    if (split_size > 1)
+    {
+        if ((double)max_features * (double)rows > (double)INT_MAX)
+        {
+            printf("Error: feature parallel split search supports at most %d candidates per node, got: %zu\n",
+                   INT_MAX, max_features * rows);
+            exit(1);
+        }
+
+        struct
+        {
+            double gini;
+            int order;
+        } local = {best.score, best.order == SIZE_MAX ? INT_MAX : (int)best.order}, global;
+
+        int64_t reduce_start = timer_now();
+        MPI_Allreduce(&local, &global, 1, MPI_DOUBLE_INT, MPI_MINLOC, split_comm);
+        timer_add(PHASE_REDUCE, reduce_start);
+
+        // Ranks that did not find the winning split recompute its halves locally below, which is
+        // cheaper than sending the rows.
+        if (global.order != local.order)
+        {
+            size_t i = (size_t)global.order / rows;
+            size_t j = (size_t)global.order % rows;
+
+            if (best_data_split)
+                free_decision_tree_data(best_data_split);
+            best_data_split = NULL;
+
+            best.index = features[i];
+            best.value = ctx->extra_trees ? random_threshold(data, rows, best.index, draws[i]) : data[j][best.index];
+            best.score = global.gini;
+        }
+    }
+
+    if (best_data_split == NULL && best.index != INT_MAX)
+    {
+        PerfSample partition_sample;
+        perf_begin(&partition_sample);
+        best_data_split = split_dataset(best.index, best.value, data, rows, cols);
+        if (order)
+            split_order(order, data, rows, cols, best.index, best.value, best_data_split,
+                        scratch->side, scratch->renumbered);
+        perf_add(PERF_PARTITION, &partition_sample);
+
+        work.rows_partitioned += (long)rows;
+        work.bytes += (long)(rows * sizeof(double *) + 2 * sizeof(DecisionTreeData));
+        if (order)
+            work.bytes += (long)(rows * (cols - 1) * sizeof(uint32_t));
+    }
+    tree_stats_add(stats, &work);
+
+    perf_add(PERF_SPLIT_SEARCH, &search_sample);
+    return (DecisionTreeDataSplit){best.index, best.value, best.score, best_data_split};
+}
+
+/*
+One half of the rows of a split node, to become either a leaf or the root of a subtree.
+*/
+typedef struct GrowHalf
+{
+    DecisionTreeNode *parent;
+    int side; // 0 for the left half, 1 for the right half.
+    DecisionTreeData half;
+    size_t max_depth;
+    size_t min_samples_leaf;
+    size_t max_features;
+    size_t depth;
+    size_t rows;
+    size_t cols;
+    NodeArena *arena;
+    const ModelContext *ctx;
+    RandomState rng;
+    double node_mean; // Regression prediction of an empty half.
+} GrowHalf;
+
+static void grow_half(GrowHalf *h)
+{
+    if (h->half.length <= h->min_samples_leaf)
+    {
+        set_leaf(h->parent, h->side, h->half.data, h->half.length /* rows */, h->cols, h->ctx, h->node_mean);
+        free(h->half.order);
+        return;
+    }
+
+    DecisionTreeDataSplit data_split = calculate_best_data_split(h->half.data,
+                                                                 h->half.order,
+                                                                 h->max_features,
+                                                                 h->half.length /* rows */,
+                                                                 h->cols,
+                                                                 h->ctx,
+                                                                 &h->arena->stats,
+                                                                 &h->rng);
+    free(h->half.order);
+
+    // Create the child of the current node on this side and populate with data from the data split.
+    DecisionTreeNode *child = empty_node(h->arena);
+    populate_split_data(child, &data_split);
+    if (h->side == 0)
+        h->parent->leftChild = child;
+    else
+        h->parent->rightChild = child;
+
+    grow(child,
+         h->max_depth,
+         h->min_samples_leaf,
+         h->max_features,
+         h->depth + 1 /* since we are now at the next 'level' in the tree */,
+         h->rows,
+         h->cols,
+         h->arena,
+         h->ctx,
+         &h->rng);
+
+    free(data_split.data);
+}
+
+static void grow_half_task(void *arg)
+{
+    grow_half(arg);
+}
+
+void grow(DecisionTreeNode *decision_tree,
+          size_t max_depth,
+          size_t min_samples_leaf,
+          size_t max_features,
+          //rufino@ip.pt: to avoid the following warning when comparing with max_depth
+          //warning: comparison of integer expressions of different signedness: ‘int’ and ‘size_t’ {aka ‘long unsigned int’}
+          //int depth,
+          size_t depth,
+          size_t rows,
+          size_t cols,
+          NodeArena *arena,
+          const ModelContext *ctx,
+          RandomState *rng)
+{
+    DecisionTreeData left_half = decision_tree->split_data_halves[0];
+    DecisionTreeData right_half = decision_tree->split_data_halves[1];
+
+    double **left = left_half.data;
+    double **right = right_half.data;
+
+    decision_tree->split_data_halves = NULL;
+
+    // Regression halves that end up empty predict the mean of the whole node.
+    double node_mean = 0.0;
+    if (ctx->regression)
+    {
+        double sum = get_leaf_node_mean(left, left_half.length, cols, 0.0) * left_half.length +
+                     get_leaf_node_mean(right, right_half.length, cols, 0.0) * right_half.length;
+        if (left_half.length + right_half.length > 0)
+            node_mean = sum / (double)(left_half.length + right_half.length);
+    }
+
+    if (left == NULL || right == NULL)
+    {
+        // If we are at the leaf node, then combine both left and right side data and compute get the leaf
+        // node class for the combined data.
+        double **combined_data = combine_arrays(left, right, left_half.length, right_half.length, cols);
+
+        set_leaf(decision_tree, 0, combined_data, rows, cols, ctx, node_mean);
+        set_leaf(decision_tree, 1, combined_data, rows, cols, ctx, node_mean);
+
+        free(left);
+        free(right);
+        free(left_half.order);
+        free(right_half.order);
+        free(combined_data);
+
+        return;
+    }
+    if (depth >= max_depth)
+    {
+        set_leaf(decision_tree, 0, left, left_half.length /* rows */, cols, ctx, node_mean);
+        set_leaf(decision_tree, 1, right, right_half.length /* rows */, cols, ctx, node_mean);
+
+        free(left);
+        free(right);
+        free(left_half.order);
+        free(right_half.order);
+
+        return;
+    }
+    // Each half gets the generator of its own node, so the subtrees can be built in any order or
+    // concurrently and still draw the same features.
+    GrowHalf halves[2] = {
+        {decision_tree, 0, left_half, max_depth, min_samples_leaf, max_features, depth, rows, cols,
+         arena, ctx, rng_child(rng, 0), node_mean},
+        {decision_tree, 1, right_half, max_depth, min_samples_leaf, max_features, depth, rows, cols,
+         arena, ctx, rng_child(rng, 1), node_mean}};
+
+    if (subtree_pool && left_half.length >= subtree_cutoff && right_half.length > min_samples_leaf)
+    {
+        // Large enough for the left subtree to be worth a task of its own: an idle worker may steal
+        // it while this thread builds the right subtree, otherwise this thread runs it when waiting.
+        TaskGroup left_subtree = TASK_GROUP_INIT;
+        thread_pool_submit(subtree_pool, &left_subtree, grow_half_task, &halves[0]);
+        grow_half(&halves[1]);
+        thread_pool_wait(subtree_pool, &left_subtree);
+    }
+    else
+    {
+        grow_half(&halves[0]);
+        grow_half(&halves[1]);
+    }
+
+    free(left);
+    free(right);
+}
+
+/*
+A node of the level being built by 'grow_level_wise': one half of a split node, like a GrowHalf,
+holding the rows 'members[begin, begin + count)'.
+*/
+typedef struct LevelEntry
+{
+    DecisionTreeNode *parent; // NULL for the root.
+    int side;
+    size_t depth;
+    RandomState rng;
+    double node_mean; // Regression prediction of an empty half.
+    size_t begin;
+    size_t count;
+} LevelEntry;
+
+/*
+Split search of a level entry that is not a leaf.
+*/
+typedef struct LevelSplit
+{
+    double **rows; // The entry's rows in node order, NULL for leaves.
+    int *features;
+    NodeTargets targets;
+    size_t n_quantiles;
+    Sweep sweep;
+    SplitCandidate best;
+} LevelSplit;
+
+DecisionTreeNode *grow_level_wise(double **data,
+                                  const uint32_t *order,
+                                  size_t rows,
+                                  size_t cols,
+                                  size_t max_depth,
+                                  size_t min_samples_leaf,
+                                  size_t max_features,
+                                  NodeArena *arena,
+                                  const ModelContext *ctx,
+                                  RandomState *rng)
+{
+    size_t n_features = cols - 1;
+
+    // The rows of the level grouped by entry in node order, the entry of every row (-1 once it
+    // reached a leaf) and its index within the entry.
+    uint32_t *members = malloc(rows * sizeof(uint32_t) + 1);
+    uint32_t *next_members = malloc(rows * sizeof(uint32_t) + 1);
+    long *assign = malloc(rows * sizeof(long) + 1);
+    uint32_t *local = malloc(rows * sizeof(uint32_t) + 1);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        members[r] = (uint32_t)r;
+        assign[r] = 0;
+        local[r] = (uint32_t)r;
+    }
+    TreeStats work = {.bytes = (long)(rows * (3 * sizeof(uint32_t) + sizeof(long)))};
+
+    DecisionTreeNode *root = NULL;
+    size_t n_entries = 1;
+    LevelEntry *entries = malloc(sizeof(LevelEntry));
+    entries[0] = (LevelEntry){NULL, 0, 0, *rng, 0.0, 0, rows};
+
+    while (n_entries > 0)
+    {
+        LevelSplit *splits = calloc(n_entries, sizeof(LevelSplit));
+        int *position = malloc(n_entries * n_features * sizeof(int));
+        for (size_t k = 0; k < n_entries * n_features; ++k)
+            position[k] = -1;
+
+        // Settle the entries that become leaves, as 'grow' and 'grow_half' would, and sample the
+        // features of all others.
+        for (size_t e = 0; e < n_entries; ++e)
+        {
+            LevelEntry *entry = &entries[e];
+            double **entry_rows = malloc(entry->count * sizeof(double *) + 1);
+            work.bytes += (long)(entry->count * sizeof(double *));
+            for (size_t k = 0; k < entry->count; ++k)
+                entry_rows[k] = data[members[entry->begin + k]];
+
+            if (entry->parent && (entry->depth >= max_depth || entry->count <= min_samples_leaf))
+            {
+                set_leaf(entry->parent, entry->side, entry_rows, entry->count, cols, ctx, entry->node_mean);
+                for (size_t k = 0; k < entry->count; ++k)
+                    assign[members[entry->begin + k]] = -1;
+                free(entry_rows);
+                continue;
+            }
+
+            LevelSplit *split = &splits[e];
+            split->rows = entry_rows;
+            split->features = malloc(max_features * sizeof(int));
+            sample_features(split->features, max_features, cols, &entry->rng);
+            split->targets = summarize_targets(entry_rows, entry->count, cols, ctx);
+            split->n_quantiles = node_quantiles(entry->count, ctx);
+            split->best = (SplitCandidate){INT_MAX, DBL_MAX, DBL_MAX, SIZE_MAX};
+            for (size_t i = split_rank; i < max_features; i += split_size)
+                position[e * n_features + split->features[i]] = (int)i;
+        }
+
+        // One pass per feature over all rows in value order sweeps every entry that sampled it.
+        for (size_t f = 0; f < n_features; ++f)
+        {
+            int sampled = 0;
+            for (size_t e = 0; e < n_entries; ++e)
+            {
+                if (position[e * n_features + f] >= 0)
+                {
+                    sweep_begin(&splits[e].sweep, ctx, &splits[e].targets);
+                    sampled = 1;
+                }
+            }
+            if (!sampled)
+                continue;
+
+            const uint32_t *list = order + f * rows;
+            for (size_t p = 0; p < rows; ++p)
+            {
+                size_t r = list[p];
+                long e = assign[r];
+                if (e < 0 || position[e * n_features + f] < 0)
+                    continue;
+
+                LevelSplit *split = &splits[e];
+                sweep_row(&split->sweep, data[r][f], data[r][cols - 1], local[r], (int)f,
+                          (size_t)position[e * n_features + f], entries[e].count, split->n_quantiles,
+                          ctx, &split->targets, &split->best);
+            }
+
+            for (size_t e = 0; e < n_entries; ++e)
+            {
+                if (position[e * n_features + f] >= 0)
+                {
+                    sweep_end(&splits[e].sweep, entries[e].count, splits[e].n_quantiles, &splits[e].best);
+                    work.candidates += (long)splits[e].sweep.candidates;
+                    work.rows_scanned += (long)splits[e].sweep.p;
+                }
+            }
+        }
+
+        // Feature parallel ranks agree on the best split of every entry of the level at once.
+        if (split_size > 1)
+        {
+            typedef struct
+            {
+                double gini;
+                int order;
+            } MinLoc;
+            MinLoc *local_best = malloc(n_entries * sizeof(MinLoc));
+            MinLoc *global_best = malloc(n_entries * sizeof(MinLoc));
+            for (size_t e = 0; e < n_entries; ++e)
+            {
+                const SplitCandidate *best = &splits[e].best;
+                if ((double)max_features * (double)entries[e].count > (double)INT_MAX)
+                {
+                    printf("Error: feature parallel split search supports at most %d candidates per node, got: %zu\n",
+                           INT_MAX, max_features * entries[e].count);
+                    exit(1);
+                }
+                local_best[e] = (MinLoc){best->score, best->order == SIZE_MAX ? INT_MAX : (int)best->order};
+            }
+
+            int64_t reduce_start = timer_now();
+            MPI_Allreduce(local_best, global_best, (int)n_entries, MPI_DOUBLE_INT, MPI_MINLOC, split_comm);
+            timer_add(PHASE_REDUCE, reduce_start);
+
+            for (size_t e = 0; e < n_entries; ++e)
+            {
+                LevelSplit *split = &splits[e];
+                if (split->rows == NULL || global_best[e].order == local_best[e].order)
+                    continue;
+
+                size_t i = (size_t)global_best[e].order / entries[e].count;
+                size_t j = (size_t)global_best[e].order % entries[e].count;
+                split->best.index = split->features[i];
+                split->best.value = split->rows[j][split->best.index];
+                split->best.score = global_best[e].gini;
+            }
+            free(local_best);
+            free(global_best);
+        }
+
+        // Split every entry into the two entries of the next level, keeping the node order.
+        LevelEntry *next = malloc(2 * n_entries * sizeof(LevelEntry) + 1);
+        size_t n_next = 0;
+        size_t filled = 0;
+        for (size_t e = 0; e < n_entries; ++e)
+        {
+            LevelEntry *entry = &entries[e];
+            LevelSplit *split = &splits[e];
+            if (split->rows == NULL)
+                continue;
+
+            DecisionTreeNode *node = empty_node(arena);
+            node->split_index = split->best.index;
+            node->split_value = split->best.value;
+            if (entry->parent == NULL)
+                root = node;
+            else if (entry->side == 0)
+                entry->parent->leftChild = node;
+            else
+                entry->parent->rightChild = node;
+
+            size_t count[2] = {0, 0};
+            double sum[2] = {0.0, 0.0};
+            for (size_t k = 0; k < entry->count; ++k)
+            {
+                int side = !(split->rows[k][node->split_index] < node->split_value);
+                count[side]++;
+                sum[side] += split->rows[k][cols - 1];
+            }
+
+            // Same arithmetic as 'grow', so that empty regression halves predict the same value.
+            double node_mean = 0.0;
+            if (ctx->regression)
+            {
+                double node_sum = (count[0] ? sum[0] / (double)count[0] : 0.0) * count[0] +
+                                  (count[1] ? sum[1] / (double)count[1] : 0.0) * count[1];
+                if (entry->count > 0)
+                    node_mean = node_sum / (double)entry->count;
+            }
+
+            size_t child_depth = entry->parent ? entry->depth + 1 : 1;
+            size_t placed[2] = {0, 0};
+            for (int side = 0; side < 2; ++side)
+                next[n_next + side] = (LevelEntry){node, side, child_depth, rng_child(&entry->rng, side), node_mean,
+                                                   filled + (side ? count[0] : 0), count[side]};
+            for (size_t k = 0; k < entry->count; ++k)
+            {
+                uint32_t r = members[entry->begin + k];
+                int side = !(data[r][node->split_index] < node->split_value);
+                next_members[next[n_next + side].begin + placed[side]] = r;
+                assign[r] = (long)(n_next + side);
+                local[r] = (uint32_t)placed[side]++;
+            }
+            n_next += 2;
+            filled += entry->count;
+            work.rows_partitioned += (long)entry->count;
+        }
+
+        for (size_t e = 0; e < n_entries; ++e)
+        {
+            free(splits[e].rows);
+            free(splits[e].features);
+            if (splits[e].rows)
+                free_node_targets(&splits[e].targets);
+        }
+        free(splits);
+        free(position);
+        free(entries);
+
+        uint32_t *swap = members;
+        members = next_members;
+        next_members = swap;
+        entries = next;
+        n_entries = n_next;
+    }
+
+    free(entries);
+    free(members);
+    free(next_members);
+    free(assign);
+    free(local);
+    tree_stats_add(&arena->stats, &work);
+    return root;
+}
+
+/*
+Impurity of the 'rows' rows of 'data' on the scale of the split scores: their Gini index, or the
+variance of their targets for regression.
+*/
+static double node_impurity(double **data, size_t rows, size_t cols, const ModelContext *ctx)
+{
+    if (rows == 0)
+        return 0.0;
+
+    if (ctx->regression)
+    {
+        double sum = 0.0, sum_sq = 0.0;
+        for (size_t j = 0; j < rows; ++j)
+        {
+            sum += data[j][cols - 1];
+            sum_sq += data[j][cols - 1] * data[j][cols - 1];
+        }
+        return sum_squared_error(rows, sum, sum_sq) / (double)rows;
+    }
+
+    long *counts = calloc(ctx->n_classes, sizeof(long));
+    for (size_t j = 0; j < rows; ++j)
+        counts[(int)data[j][cols - 1]]++;
+    double gini = gini_from_counts(counts, ctx->n_classes, rows);
+    free(counts);
+    return gini;
+}
+
+/*
+A leaf of a tree grown by 'grow_best_first': one half of a split node, like a GrowHalf. Leaves that
+may be split hold the split already found for them and how much it would lower the impurity of the
+tree.
+*/
+typedef struct LeafCandidate
+{
+    DecisionTreeNode *parent;
+    int side;
+    DecisionTreeData half;
+    size_t depth;
+    RandomState rng;
+    double node_mean; // Regression prediction of an empty half.
+    DecisionTreeDataSplit split;
+    double gain;      // Rows times the impurity decrease of 'split'.
+    long seq;         // Creation order, which breaks ties between equal gains.
+} LeafCandidate;
+
+/*
+Binary max heap of the leaves that may be split, by gain and then creation order.
+*/
+typedef struct LeafHeap
+{
+    LeafCandidate **items;
+    size_t count;
+    size_t capacity;
+} LeafHeap;
+
+static int leaf_before(const LeafCandidate *a, const LeafCandidate *b)
+{
+    return a->gain > b->gain || (a->gain == b->gain && a->seq < b->seq);
+}
+
+static void leaf_heap_push(LeafHeap *heap, LeafCandidate *leaf)
+{
+    if (heap->count == heap->capacity)
+    {
+        heap->capacity = heap->capacity ? 2 * heap->capacity : 16;
+        heap->items = realloc(heap->items, heap->capacity * sizeof(LeafCandidate *));
+    }
+
+    size_t k = heap->count++;
+    while (k > 0 && leaf_before(leaf, heap->items[(k - 1) / 2]))
+    {
+        heap->items[k] = heap->items[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    heap->items[k] = leaf;
+}
+
+static LeafCandidate *leaf_heap_pop(LeafHeap *heap)
+{
+    LeafCandidate *top = heap->items[0];
+    LeafCandidate *last = heap->items[--heap->count];
+
+    size_t k = 0;
+    for (;;)
+    {
+        size_t child = 2 * k + 1;
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count && leaf_before(heap->items[child + 1], heap->items[child]))
+            ++child;
+        if (!leaf_before(heap->items[child], last))
+            break;
+        heap->items[k] = heap->items[child];
+        k = child;
+    }
+    if (heap->count > 0)
+        heap->items[k] = last;
+    return top;
+}
+
+/*
+State of one tree grown by 'grow_best_first'.
+*/
+typedef struct BestFirstTree
+{
+    size_t max_depth;
+    size_t min_samples_leaf;
+    size_t max_features;
+    size_t split_budget; // Rows times features the split searches may still scan, if limited.
+    int limited;         // Set if 'split_budget' applies.
+    size_t cols;
+    NodeArena *arena;
+    long seq;
+    const ModelContext *ctx;
+    LeafHeap heap;
+} BestFirstTree;
+
+/*
+Turns the halves of the split of 'node', grown at 'depth' from generator 'rng', into leaves. The
+halves that 'grow' would split and that fit in the budget get their split searched and are queued,
+the others are final leaves right away.
+*/
+static void add_leaves(BestFirstTree *tree, DecisionTreeNode *node, size_t depth, const RandomState *rng)
+{
+    DecisionTreeData *halves = node->split_data_halves;
+    node->split_data_halves = NULL;
+    size_t cols = tree->cols;
+    const ModelContext *ctx = tree->ctx;
+
+    // Regression halves that end up empty predict the mean of the whole node, as in 'grow'.
+    double node_mean = 0.0;
+    if (ctx->regression)
+    {
+        double sum = get_leaf_node_mean(halves[0].data, halves[0].length, cols, 0.0) * halves[0].length +
+                     get_leaf_node_mean(halves[1].data, halves[1].length, cols, 0.0) * halves[1].length;
+        if (halves[0].length + halves[1].length > 0)
+            node_mean = sum / (double)(halves[0].length + halves[1].length);
+    }
+
+    for (int side = 0; side < 2; ++side)
+    {
+        LeafCandidate *leaf = malloc(sizeof(LeafCandidate));
+        *leaf = (LeafCandidate){node, side, halves[side], depth, rng_child(rng, side), node_mean, {0}, 0.0, tree->seq++};
+
+        size_t cost = leaf->half.length * tree->max_features;
+        if (depth < tree->max_depth && leaf->half.length > tree->min_samples_leaf &&
+            (!tree->limited || cost <= tree->split_budget))
+        {
+            tree->split_budget -= tree->limited ? cost : 0;
+            leaf->split = calculate_best_data_split(leaf->half.data, leaf->half.order, tree->max_features,
+                                                    leaf->half.length, cols, ctx, &tree->arena->stats, &leaf->rng);
+            leaf->gain = (double)leaf->half.length *
+                         (node_impurity(leaf->half.data, leaf->half.length, cols, ctx) - leaf->split.gini);
+            free(leaf->half.order);
+            leaf->half.order = NULL;
+            leaf_heap_push(&tree->heap, leaf);
+            continue;
+        }
+
+        set_leaf(node, side, leaf->half.data, leaf->half.length, cols, ctx, node_mean);
+        free(leaf->half.data);
+        free(leaf->half.order);
+        free(leaf);
+    }
+    free(halves);
+}
+
+DecisionTreeNode *grow_best_first(double **data,
+                                  const uint32_t *order,
+                                  size_t rows,
+                                  size_t cols,
+                                  size_t max_depth,
+                                  size_t min_samples_leaf,
+                                  size_t max_features,
+                                  size_t max_leaves,
+                                  size_t split_budget,
+                                  NodeArena *arena,
+                                  const ModelContext *ctx,
+                                  RandomState *rng)
+{
+    BestFirstTree tree = {max_depth, min_samples_leaf, max_features, split_budget, split_budget > 0,
+                          cols, arena, 0, ctx, {NULL, 0, 0}};
+
+    // The root is always split, as in 'train_model_tree'.
+    DecisionTreeNode *root = empty_node(arena);
+    DecisionTreeDataSplit root_split = calculate_best_data_split(data, order, max_features, rows, cols, ctx,
+                                                                 &arena->stats, rng);
+    populate_split_data(root, &root_split);
+    size_t root_cost = rows * max_features;
+    if (tree.limited)
+        tree.split_budget -= root_cost < split_budget ? root_cost : split_budget;
+    add_leaves(&tree, root, 1, rng);
+    size_t n_leaves = 2;
+
+    // Split the leaf that lowers the impurity the most until the tree has 'max_leaves' leaves.
+    while (tree.heap.count > 0 && (max_leaves == 0 || n_leaves < max_leaves))
+    {
+        LeafCandidate *leaf = leaf_heap_pop(&tree.heap);
+
+        DecisionTreeNode *child = empty_node(arena);
+        populate_split_data(child, &leaf->split);
+        if (leaf->side == 0)
+            leaf->parent->leftChild = child;
+        else
+            leaf->parent->rightChild = child;
+
+        add_leaves(&tree, child, leaf->depth + 1, &leaf->rng);
+        ++n_leaves;
+
+        free(leaf->half.data);
+        free(leaf);
+    }
+
+    // Whatever is left over stays a leaf.
+    while (tree.heap.count > 0)
+    {
+        LeafCandidate *leaf = leaf_heap_pop(&tree.heap);
+        set_leaf(leaf->parent, leaf->side, leaf->half.data, leaf->half.length, cols, ctx, leaf->node_mean);
+        free_decision_tree_data(leaf->split.data);
+        free(leaf->half.data);
+        free(leaf);
+    }
+    free(tree.heap.items);
+    return root;
+}
+
+void make_prediction(const DecisionTreeNode *decision_tree, double *row, int *prediction_val)
+{
+    if (row[decision_tree->split_index] < decision_tree->split_value)
+    {
+        if (decision_tree->leftChild != NULL)
+            make_prediction(decision_tree->leftChild, row, prediction_val);
+        else
+            (*prediction_val) = decision_tree->left_leaf;
+    }
+    else
+    {
+        if (decision_tree->rightChild != NULL)
+            make_prediction(decision_tree->rightChild, row, prediction_val);
+        else
+            (*prediction_val) = decision_tree->right_leaf;
+    }
+}
+
+void make_prediction_value(const DecisionTreeNode *decision_tree, double *row, double *prediction_val)
+{
+    if (row[decision_tree->split_index] < decision_tree->split_value)
+    {
+        if (decision_tree->leftChild != NULL)
+            make_prediction_value(decision_tree->leftChild, row, prediction_val);
+        else
+            (*prediction_val) = decision_tree->left_value;
+    }
+    else
+    {
+        if (decision_tree->rightChild != NULL)
+            make_prediction_value(decision_tree->rightChild, row, prediction_val);
+        else
+            (*prediction_val) = decision_tree->right_value;
+    }
+}
+
+/*
+Frees every node of the tree whose root is 'node'. The root is the first node of the first chunk
+of its arena, which leads to the other chunks of the tree.
+*/
+void free_decision_tree_node(const DecisionTreeNode *node, long *freeCount)
+{
+    NodeChunk *chunk = (NodeChunk *)((char *)node - offsetof(NodeChunk, nodes));
+    while (chunk)
+    {
+        NodeChunk *next = chunk->next;
+
+        log_if_level(2, "freeing %zu DecisionTreeNodes from id=%ld\n", chunk->used, chunk->nodes[0].id);
+
+        (*freeCount) += (long)chunk->used;
+        free(chunk);
+        chunk = next;
+    }
 }
 
 /*
@@ -458,5 +1748,7 @@ void free_decision_tree_data(DecisionTreeData *data_split)
 {
     free(data_split[0].data);
     free(data_split[1].data);
+    free(data_split[0].order);
+    free(data_split[1].order);
     free(data_split);
 }
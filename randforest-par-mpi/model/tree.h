@@ -12,13 +12,20 @@
 
 #include <float.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <mpi.h>
+#include <pthread.h>
 #include "../utils/utils.h"
 #include "../utils/log.h" // rufino@ipb.pt
+#include "../utils/rng.h"
+#include "../utils/threadpool.h"
 
 typedef struct DecisionTreeData DecisionTreeData;
 typedef struct DecisionTreeNode DecisionTreeNode;
 typedef struct DecisionTreeDataSplit DecisionTreeDataSplit;
-typedef struct DecisionTreeTargetClasses DecisionTreeTargetClasses;
+typedef struct NodeChunk NodeChunk;
+typedef struct NodeArena NodeArena;
+typedef struct TreeStats TreeStats;
 
 /*
 Represents a single node in a decision tree that comprise a random forest.
@@ -41,12 +48,18 @@ struct DecisionTreeNode
     // if the node is a leaf
     int left_leaf;
     int right_leaf;
+
+    // Leaf predictions of regression trees: the mean target of the training rows of each side.
+    double left_value;
+    double right_value;
 };
 
 struct DecisionTreeData
 {
     size_t length;
     double **data;
+    uint32_t *order; // With a presort: for every feature, the indices into 'data' of the rows
+                     // sorted by its value, like 'Presort.order'. NULL otherwise.
 };
 
 struct DecisionTreeDataSplit
@@ -57,23 +70,122 @@ struct DecisionTreeDataSplit
     DecisionTreeData *data;
 };
 
-struct DecisionTreeTargetClasses
+// Nodes of the first chunk of a tree, later chunks double up to NODE_CHUNK_MAX.
+#define NODE_CHUNK_MIN 64
+#define NODE_CHUNK_MAX 4096
+
+/*
+A contiguous block of nodes. The chunks of a tree are chained from the one holding its root.
+*/
+struct NodeChunk
+{
+    NodeChunk *next;
+    size_t used;
+    size_t capacity;
+    DecisionTreeNode nodes[];
+};
+
+/*
+Work done to build one tree, counted by the builders as they go. Threads growing subtrees of the
+same tree add to it atomically.
+*/
+struct TreeStats
+{
+    long candidates;       // Split thresholds scored.
+    long rows_scanned;     // Rows visited by the split search, once per pass over a sampled feature.
+    long rows_partitioned; // Rows moved into the halves of a split.
+    long bytes;            // Bytes allocated for the nodes, row partitions and histograms of the tree.
+    long nodes;            // Filled in by 'measure_tree' once the tree is built.
+    long leaves;
+    long max_depth;
+};
+
+/*
+Adds the counters of 'delta' to 'stats', which other threads may be updating.
+*/
+void tree_stats_add(TreeStats *stats, const TreeStats *delta);
+
+/*
+Counts the nodes, leaves and depth of the tree rooted at 'root' into 'stats'. Every side of a node
+that has no child is a leaf, so a tree of 'n' nodes has 'n + 1' leaves.
+*/
+void measure_tree(const DecisionTreeNode *root, TreeStats *stats);
+
+/*
+Bump allocator and ID generator for the nodes of a single tree. The first node allocated is the
+root of the tree. Subtrees of one tree may be grown by several threads, so allocations take 'lock'.
+The chunks outlive the arena: once the tree is built they belong to it and are released with
+'free_decision_tree_node' on its root.
+*/
+struct NodeArena
 {
-    size_t count;
-    int *labels;
+    long next_id;
+    NodeChunk *first;
+    NodeChunk *last;
+    pthread_mutex_t lock;
+    TreeStats stats; // Work of the builder, which also counts the bytes of the chunks.
 };
 
+void node_arena_init(NodeArena *arena);
+
+/*
+Releases the lock of the arena but none of its nodes.
+*/
+void node_arena_finish(NodeArena *arena);
+
 /*
-Functions to free memory allocated for the structs.
+Functions to free memory allocated for the structs. 'free_decision_tree_node' takes the root of a
+tree built from a NodeArena and frees all of its nodes a chunk at a time, adding their number to
+'freeCount'.
 */
 void free_decision_tree_data(DecisionTreeData *data_split);
 void free_decision_tree_node(const DecisionTreeNode *node, long *freeCount);
 
 /*
-Creates a new empry DecisionTreeNode with id from the strictly increasing
-id generator.
+Creates a new empty DecisionTreeNode in 'arena' with the next id of its strictly increasing id
+generator.
+*/
+DecisionTreeNode *empty_node(NodeArena *arena);
+
+/*
+Builds a whole decision tree on the 'rows' rows of 'data' breadth first and returns its root,
+instead of recursing like 'calculate_best_data_split' and 'grow'. Each level makes one pass per
+feature over the rows in the presorted 'order' (see 'Presort'), routing every row to the node of
+the level it belongs to through a node assignment array and sweeping the candidates of all nodes
+that sampled the feature together. Gives the same tree as the recursive builder with the same
+generator 'rng', and with feature parallel ranks exchanges the splits of a whole level at once.
+*/
+DecisionTreeNode *grow_level_wise(double **data,
+                                  const uint32_t *order,
+                                  size_t rows,
+                                  size_t cols,
+                                  size_t max_depth,
+                                  size_t min_samples_leaf,
+                                  size_t max_features,
+                                  NodeArena *arena,
+                                  const ModelContext *ctx,
+                                  RandomState *rng);
+
+/*
+Builds a whole decision tree on the 'rows' rows of 'data' best first and returns its root. Each leaf
+that 'grow' would split gets its best split searched as soon as it is created, and the leaf whose
+split lowers the impurity of the tree the most (weighted by its rows) is split next. Stops once the
+tree has 'max_leaves' leaves, or when the split searches have scanned 'split_budget' rows times
+'max_features' features in total, 0 meaning no limit. Without limits it gives the same tree as 'grow'.
+'order' is the presorted order of 'data' like for 'calculate_best_data_split', or NULL.
 */
-DecisionTreeNode *empty_node(long *id);
+DecisionTreeNode *grow_best_first(double **data,
+                                  const uint32_t *order,
+                                  size_t rows,
+                                  size_t cols,
+                                  size_t max_depth,
+                                  size_t min_samples_leaf,
+                                  size_t max_features,
+                                  size_t max_leaves,
+                                  size_t split_budget,
+                                  NodeArena *arena,
+                                  const ModelContext *ctx,
+                                  RandomState *rng);
 
 /*
 Function to recursively grow a DecisionTreeNode by splitting the dataset and creating 
@@ -89,18 +201,71 @@ void grow(DecisionTreeNode *decision_tree,
           size_t depth,
           size_t rows,
           size_t cols,
-          long *nodeId,
-          const ModelContext *ctx);
+          NodeArena *arena,
+          const ModelContext *ctx,
+          RandomState *rng);
+
+/*
+Sets the communicator of the ranks that build the same trees together. Each rank of 'comm' then
+evaluates only its share of the features sampled at every node, and the best split is agreed on
+with MPI_MINLOC. Defaults to MPI_COMM_SELF, i.e. every rank searches all features alone.
+*/
+void set_split_comm(MPI_Comm comm);
+
+/*
+Makes 'grow' hand the left subtree of every node with at least 'cutoff' rows on that side to 'pool'
+as a task while it builds the right one, so that idle workers can steal parts of a tree. NULL
+grows every tree on the calling thread only.
+*/
+void set_subtree_pool(ThreadPool *pool, size_t cutoff);
+
+/*
+Fills 'features' with 'max_features' distinct, randomly selected feature (column) indices in
+[0, cols - 2], i.e. never the class target column, drawn from the node's generator 'rng'.
+*/
+void sample_features(int *features, size_t max_features, size_t cols, RandomState *rng);
+
+/*
+Sizes the split search buffers of the calling thread for nodes of up to 'rows' rows, so that
+'calculate_best_data_split' allocates nothing while growing a tree. The buffers belong to the thread
+and are reused by all its trees; worker threads free theirs when they exit, other threads release
+them with 'release_split_scratch'.
+*/
+void reserve_split_scratch(size_t max_features, size_t rows, size_t n_classes);
+void release_split_scratch(void);
 
 /*
 Calculates the best split for the 'data' given a number of randomly selected features from the data
-(columns) up to the number of maximum number of features 'max_features'.
+(columns) up to the number of maximum number of features 'max_features'. Every value of a feature is
+a candidate threshold once, or only 'ctx->n_quantiles' quantiles of them in nodes of more than
+'ctx->quantile_rows' rows. With 'ctx->extra_trees' set each feature instead tries one threshold
+drawn uniformly between its minimum and maximum in 'data', which takes a single pass over the rows.
+
+'order' holds the rows of 'data' sorted by every feature (see 'DecisionTreeData'), or is NULL to
+sort the sampled features here. With an 'order', the halves of the split get theirs too. The work
+of the search is added to 'stats'.
 */
 DecisionTreeDataSplit calculate_best_data_split(double **data,
+                                                const uint32_t *order,
                                                 size_t max_features,
                                                 size_t rows,
                                                 size_t cols,
-                                                const ModelContext *ctx);
+                                                const ModelContext *ctx,
+                                                TreeStats *stats,
+                                                RandomState *rng);
+
+/*
+Given a two dimensional array of data and parameters for a split, splits the data into two halves and
+returns a pointer to an array of two DecisionTreeData for the two halves of the split, which are
+released with 'free_decision_tree_data'.
+*/
+DecisionTreeData *split_dataset(int feature_index, double value, double **data, size_t rows, size_t cols);
+
+/*
+Gini impurity of a group of 'n' rows whose class targets are distributed as in the 'n_classes'
+counts of 'counts'.
+*/
+double gini_from_counts(const long *counts, size_t n_classes, size_t n);
 
 /*
 Populates a given DecisionTreeNode with data from the DecisionTreeDataSplit struct 
@@ -113,4 +278,9 @@ and writes the prediction into the variable pointed to 'prediction_val'.
 */
 void make_prediction(const DecisionTreeNode *decision_tree, double *row, int *prediction_val);
 
+/*
+Regression counterpart of 'make_prediction': writes the leaf mean reached by 'row' into 'prediction_val'.
+*/
+void make_prediction_value(const DecisionTreeNode *decision_tree, double *row, double *prediction_val);
+
 #endif // tree_h
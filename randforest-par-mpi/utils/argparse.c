@@ -17,6 +17,29 @@
     //arguments->random_seed = 0;
     arguments->random_seed = RAND_MAX;
     arguments->args[0] = NULL;
+    arguments->colstore = NULL;
+    arguments->mem_budget = 1024;
+    arguments->n_bins = 256;
+    arguments->row_shard = 0;
+    arguments->feature_ranks = 1;
+    arguments->threads = 1;
+    arguments->subtree_cutoff = 256;
+    arguments->regression = 0;
+    arguments->extra_trees = 0;
+    arguments->quantile_rows = 4096;
+    arguments->n_quantiles = 256;
+    arguments->level_wise = 0;
+    arguments->max_leaves = 0;
+    arguments->split_budget = 0;
+    arguments->log_file = NULL;
+    arguments->timings = NULL;
+    arguments->trace = NULL;
+    arguments->perf_counters = 0;
+    arguments->n_estimators = 20;
+    arguments->max_depth = 7;
+    arguments->min_samples_leaf = 3;
+    arguments->max_features = 20;
+    arguments->k_folds = 20;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], ARG_KEY_ROWS) == 0 && i + 1 < argc) {
@@ -31,6 +54,52 @@
             arguments->log_level = atoi(argv[++i]);
         } else if (strcmp(argv[i], ARG_KEY_SEED) == 0 && i + 1 < argc) {
             arguments->random_seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_COLSTORE) == 0 && i + 1 < argc) {
+            arguments->colstore = argv[++i];
+        } else if (strcmp(argv[i], ARG_KEY_MEM_BUDGET) == 0 && i + 1 < argc) {
+            arguments->mem_budget = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_N_BINS) == 0 && i + 1 < argc) {
+            arguments->n_bins = atoi(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_ROW_SHARD) == 0) {
+            arguments->row_shard = 1;
+        } else if (strcmp(argv[i], ARG_KEY_FEATURE_RANKS) == 0 && i + 1 < argc) {
+            arguments->feature_ranks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_THREADS) == 0 && i + 1 < argc) {
+            arguments->threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_SUBTREE_CUTOFF) == 0 && i + 1 < argc) {
+            arguments->subtree_cutoff = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_REGRESSION) == 0) {
+            arguments->regression = 1;
+        } else if (strcmp(argv[i], ARG_KEY_EXTRA_TREES) == 0) {
+            arguments->extra_trees = 1;
+        } else if (strcmp(argv[i], ARG_KEY_QUANTILE_ROWS) == 0 && i + 1 < argc) {
+            arguments->quantile_rows = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_N_QUANTILES) == 0 && i + 1 < argc) {
+            arguments->n_quantiles = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_LEVEL_WISE) == 0) {
+            arguments->level_wise = 1;
+        } else if (strcmp(argv[i], ARG_KEY_MAX_LEAVES) == 0 && i + 1 < argc) {
+            arguments->max_leaves = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_SPLIT_BUDGET) == 0 && i + 1 < argc) {
+            arguments->split_budget = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_LOG_FILE) == 0 && i + 1 < argc) {
+            arguments->log_file = argv[++i];
+        } else if (strcmp(argv[i], ARG_KEY_TIMINGS) == 0 && i + 1 < argc) {
+            arguments->timings = argv[++i];
+        } else if (strcmp(argv[i], ARG_KEY_TRACE) == 0 && i + 1 < argc) {
+            arguments->trace = argv[++i];
+        } else if (strcmp(argv[i], ARG_KEY_PERF_COUNTERS) == 0) {
+            arguments->perf_counters = 1;
+        } else if (strcmp(argv[i], ARG_KEY_N_ESTIMATORS) == 0 && i + 1 < argc) {
+            arguments->n_estimators = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_MAX_DEPTH) == 0 && i + 1 < argc) {
+            arguments->max_depth = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_MIN_SAMPLES_LEAF) == 0 && i + 1 < argc) {
+            arguments->min_samples_leaf = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_MAX_FEATURES) == 0 && i + 1 < argc) {
+            arguments->max_features = atol(argv[++i]);
+        } else if (strcmp(argv[i], ARG_KEY_K_FOLDS) == 0 && i + 1 < argc) {
+            arguments->k_folds = atoi(argv[++i]);
         } else if (arguments->args[0] == NULL) {
             arguments->args[0] = argv[i]; // CSV file
         }
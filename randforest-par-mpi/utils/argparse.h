@@ -29,6 +29,29 @@ extern const char *argp_program_bug_address;
 #define ARG_KEY_COLS "--num_cols"
 #define ARG_KEY_LOG_LEVEL "--log_level"
 #define ARG_KEY_SEED "--seed"
+#define ARG_KEY_COLSTORE "--colstore"
+#define ARG_KEY_MEM_BUDGET "--mem_budget"
+#define ARG_KEY_N_BINS "--n_bins"
+#define ARG_KEY_ROW_SHARD "--row_shard"
+#define ARG_KEY_FEATURE_RANKS "--feature_ranks"
+#define ARG_KEY_THREADS "--threads"
+#define ARG_KEY_SUBTREE_CUTOFF "--subtree_cutoff"
+#define ARG_KEY_REGRESSION "--regression"
+#define ARG_KEY_EXTRA_TREES "--extra_trees"
+#define ARG_KEY_QUANTILE_ROWS "--quantile_rows"
+#define ARG_KEY_N_QUANTILES "--n_quantiles"
+#define ARG_KEY_LEVEL_WISE "--level_wise"
+#define ARG_KEY_MAX_LEAVES "--max_leaves"
+#define ARG_KEY_SPLIT_BUDGET "--split_budget"
+#define ARG_KEY_LOG_FILE "--log_file"
+#define ARG_KEY_TIMINGS "--timings"
+#define ARG_KEY_TRACE "--trace"
+#define ARG_KEY_PERF_COUNTERS "--perf_counters"
+#define ARG_KEY_N_ESTIMATORS "--n_estimators"
+#define ARG_KEY_MAX_DEPTH "--max_depth"
+#define ARG_KEY_MIN_SAMPLES_LEAF "--min_samples_leaf"
+#define ARG_KEY_MAX_FEATURES "--max_features"
+#define ARG_KEY_K_FOLDS "--k_folds"
 
 /* Used by main to communicate with parse_opt. */
 struct arguments
@@ -38,6 +61,30 @@ struct arguments
     long rows, cols;
     int log_level;
     int random_seed;
+
+    char *colstore;  /* Column store file used for out-of-core training, NULL to train in memory. */
+    long mem_budget; /* Per-process memory budget of out-of-core training in MB. */
+    int n_bins;      /* Histogram bins per feature for out-of-core training. */
+    int row_shard;   /* Shard rows instead of trees across processes. */
+    int feature_ranks; /* Processes splitting the split search of each tree. */
+    int threads;     /* Worker threads building trees inside each process. */
+    long subtree_cutoff; /* Minimum rows of a subtree grown as a separate task, 0 to disable. */
+    int regression;  /* Fit a regression forest on real valued targets. */
+    int extra_trees; /* Split on one random threshold per feature (ExtraTrees). */
+    long quantile_rows; /* Nodes with more rows only try quantile thresholds, 0 to disable. */
+    long n_quantiles;   /* Quantile thresholds per feature of such nodes. */
+    int level_wise;  /* Build in-memory trees breadth first. */
+    long max_leaves;   /* Leaves per tree grown best first, 0 for no limit. */
+    long split_budget; /* Rows times features scanned by the split searches of a tree, 0 for no limit. */
+    char *log_file;  /* Prefix of the per-process log files, NULL to log to stdout. */
+    char *timings;   /* JSON file receiving the phase timers of every process, NULL for none. */
+    char *trace;     /* Chrome trace file of the timeline of every process, NULL to not trace. */
+    int perf_counters; /* Count hardware events of the training phases with perf_event_open. */
+    long n_estimators;     /* Trees in the forest. */
+    long max_depth;        /* Maximum depth of a tree. */
+    long min_samples_leaf; /* Rows at or below which a half becomes a leaf. */
+    long max_features;     /* Features sampled at every split. */
+    int k_folds;           /* Folds of the cross validation. */
 };
 
 
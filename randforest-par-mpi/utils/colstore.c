@@ -0,0 +1,309 @@
+/*
+Columnar binary storage used by out-of-core training.
+*/
+
+// pread/pwrite/ftruncate and getline are POSIX, and stores can be larger than 2 GB.
+#define _XOPEN_SOURCE 700
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "colstore.h"
+#include "log.h"
+
+/*
+Byte offset of the first value of row 'row' in column 'col'.
+*/
+static off_t colstore_offset(const struct dim *dim, size_t col, size_t row)
+{
+    return (off_t)sizeof(struct ColumnStoreHeader) + ((off_t)col * dim->rows + row) * (off_t)sizeof(double);
+}
+
+/*
+Returns 1 if the line only holds whitespace, such as a trailing newline at the end of the file.
+*/
+static int is_blank_line(const char *line)
+{
+    for (; *line; ++line)
+    {
+        if (*line != ' ' && *line != '\t' && *line != '\r' && *line != '\n')
+            return 0;
+    }
+    return 1;
+}
+
+/*
+Counts the rows and columns of a csv file reading one line at a time, unlike 'parse_csv_dims'
+which allocates a line buffer as large as the whole file.
+*/
+static struct dim stream_csv_dims(FILE *csv_file, const char *file_name)
+{
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+    int skipped_header = !CSV_HAS_HEADER;
+
+    while (getline(&line, &line_cap, csv_file) != -1)
+    {
+        if (!skipped_header)
+        {
+            skipped_header = 1;
+            continue;
+        }
+        if (is_blank_line(line))
+            continue;
+
+        size_t curr_cols = 1;
+        for (const char *c = line; *c; ++c)
+        {
+            if (*c == ',')
+                ++curr_cols;
+        }
+        if (cols == 0)
+            cols = curr_cols;
+        else if (curr_cols != cols)
+        {
+            printf("Error: every row must have the same amount of columns, row %zu of %s has %zu (expected %zu)\n",
+                   rows + 1, file_name, curr_cols, cols);
+            exit(-1);
+        }
+        ++rows;
+    }
+    free(line);
+
+    if (rows == 0 || cols == 0)
+    {
+        printf("Error: csv file %s holds no data\n", file_name);
+        exit(-1);
+    }
+    return (struct dim){.rows = rows, .cols = cols};
+}
+
+/*
+Writes 'count' rows held row-major in 'rows_buf' into every column of the store at row 'first_row'.
+*/
+static void flush_row_chunk(int fd,
+                            const struct dim *dim,
+                            const double *rows_buf,
+                            double *col_buf,
+                            size_t first_row,
+                            size_t count)
+{
+    for (size_t j = 0; j < dim->cols; ++j)
+    {
+        for (size_t i = 0; i < count; ++i)
+            col_buf[i] = rows_buf[i * dim->cols + j];
+
+        size_t bytes = count * sizeof(double);
+        if (pwrite(fd, col_buf, bytes, colstore_offset(dim, j, first_row)) != (ssize_t)bytes)
+        {
+            printf("Error: failed to write column %zu to column store\n", j);
+            exit(-1);
+        }
+    }
+}
+
+void csv_to_colstore(const char *csv_file, const char *store_file, size_t mem_budget)
+{
+    FILE *csv = fopen(csv_file, "r");
+    if (csv == NULL)
+    {
+        printf("Error: can't open file: %s\n", csv_file);
+        exit(-1);
+    }
+
+    struct dim dim = stream_csv_dims(csv, csv_file);
+    rewind(csv);
+
+    int fd = open(store_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("Error: can't create column store: %s\n", store_file);
+        exit(-1);
+    }
+
+    struct ColumnStoreHeader header = {.rows = dim.rows, .cols = dim.cols};
+    memcpy(header.magic, COLSTORE_MAGIC, sizeof(header.magic));
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        ftruncate(fd, colstore_offset(&dim, dim.cols, 0)) != 0)
+    {
+        printf("Error: failed to write column store header: %s\n", store_file);
+        exit(-1);
+    }
+
+    // Half of the budget holds a chunk of parsed rows, the other half the transposed column
+    // segment of that chunk being written out.
+    size_t chunk_rows = mem_budget / (2 * dim.cols * sizeof(double));
+    if (chunk_rows == 0)
+        chunk_rows = 1;
+    if (chunk_rows > dim.rows)
+        chunk_rows = dim.rows;
+
+    double *rows_buf = malloc(chunk_rows * dim.cols * sizeof(double));
+    double *col_buf = malloc(chunk_rows * sizeof(double));
+    if (!rows_buf || !col_buf)
+    {
+        printf("Error: failed to allocate %zu row conversion buffer\n", chunk_rows);
+        exit(-1);
+    }
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t row = 0;
+    size_t in_chunk = 0;
+    int skipped_header = !CSV_HAS_HEADER;
+
+    while (row < dim.rows && getline(&line, &line_cap, csv) != -1)
+    {
+        if (!skipped_header)
+        {
+            skipped_header = 1;
+            continue;
+        }
+        if (is_blank_line(line))
+            continue;
+
+        double *values = rows_buf + in_chunk * dim.cols;
+        size_t col = 0;
+        for (char *token = strtok(line, ","); token != NULL && col < dim.cols; token = strtok(NULL, ","))
+            values[col++] = atof(token);
+
+        ++row;
+        if (++in_chunk == chunk_rows)
+        {
+            flush_row_chunk(fd, &dim, rows_buf, col_buf, row - in_chunk, in_chunk);
+            in_chunk = 0;
+        }
+    }
+    if (in_chunk > 0)
+        flush_row_chunk(fd, &dim, rows_buf, col_buf, row - in_chunk, in_chunk);
+
+    log_if_level(1, "wrote %zu rows x %zu cols from %s to column store %s\n", dim.rows, dim.cols, csv_file, store_file);
+
+    free(line);
+    free(rows_buf);
+    free(col_buf);
+    close(fd);
+    fclose(csv);
+}
+
+ColumnStore colstore_open(const char *store_file)
+{
+    int fd = open(store_file, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error: can't open column store: %s\n", store_file);
+        exit(-1);
+    }
+
+    struct ColumnStoreHeader header;
+    if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, COLSTORE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        printf("Error: %s is not a column store file\n", store_file);
+        exit(-1);
+    }
+
+    return (ColumnStore){.fd = fd, .dim = {.rows = header.rows, .cols = header.cols}};
+}
+
+void colstore_close(ColumnStore *store)
+{
+    close(store->fd);
+    store->fd = -1;
+}
+
+static void read_store_column(const ColumnSource *src, size_t col, size_t begin, size_t count, double *out)
+{
+    const ColumnStore *store = src->handle;
+    size_t bytes = count * sizeof(double);
+    size_t done = 0;
+
+    // 'pread' may return short counts for very large requests, so keep reading until done.
+    while (done < bytes)
+    {
+        ssize_t n = pread(store->fd,
+                          (char *)out + done,
+                          bytes - done,
+                          colstore_offset(&store->dim, col, src->row_offset + begin) + (off_t)done);
+        if (n <= 0)
+        {
+            printf("Error: failed to read column %zu rows [%zu, %zu) from column store\n", col, begin, begin + count);
+            exit(-1);
+        }
+        done += (size_t)n;
+    }
+}
+
+ColumnSource column_source_from_store(const ColumnStore *store)
+{
+    return (ColumnSource){
+        .dim = store->dim,
+        .row_offset = 0,
+        .total_rows = store->dim.rows,
+        .read_column = read_store_column,
+        .handle = store};
+}
+
+static void read_rows_column(const ColumnSource *src, size_t col, size_t begin, size_t count, double *out)
+{
+    const double *data = src->handle;
+    size_t cols = src->dim.cols;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = data[(begin + i) * cols + col];
+}
+
+ColumnSource column_source_from_rows(const double *data, struct dim dim, size_t row_offset, size_t total_rows)
+{
+    return (ColumnSource){
+        .dim = dim,
+        .row_offset = row_offset,
+        .total_rows = total_rows,
+        .read_column = read_rows_column,
+        .handle = data};
+}
+
+void shard_rows(size_t rows, int part, int parts, size_t *begin, size_t *count)
+{
+    size_t per_part = rows / parts;
+    size_t remainder = rows % parts;
+    size_t p = (size_t)part;
+
+    *begin = p * per_part + (p < remainder ? p : remainder);
+    *count = per_part + (p < remainder ? 1 : 0);
+}
+
+ColumnSource column_source_shard(const ColumnSource *src, int part, int parts)
+{
+    size_t begin, count;
+    shard_rows(src->dim.rows, part, parts, &begin, &count);
+
+    ColumnSource shard = *src;
+    shard.dim.rows = count;
+    shard.row_offset = src->row_offset + begin;
+    return shard;
+}
+
+double *column_source_load_rows(const ColumnSource *src)
+{
+    size_t rows = src->dim.rows;
+    size_t cols = src->dim.cols;
+    double *data = malloc((rows > 0 ? rows : 1) * cols * sizeof(double));
+    double *column = malloc((rows > 0 ? rows : 1) * sizeof(double));
+    if (!data || !column)
+    {
+        printf("Error: failed to allocate %zu rows x %zu cols\n", rows, cols);
+        exit(-1);
+    }
+
+    for (size_t j = 0; j < cols; ++j)
+    {
+        src->read_column(src, j, 0, rows, column);
+        for (size_t i = 0; i < rows; ++i)
+            data[i * cols + j] = column[i];
+    }
+
+    free(column);
+    return data;
+}
@@ -0,0 +1,102 @@
+/*
+Columnar binary storage used by out-of-core training.
+*/
+
+#ifndef colstore_h
+#define colstore_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "data.h"
+
+/*
+File layout: a fixed header followed by 'cols' contiguous columns of 'rows' doubles each, so a
+single feature can be streamed from disk without touching the bytes of any other feature.
+*/
+#define COLSTORE_MAGIC "RFCOLS01"
+
+struct ColumnStoreHeader
+{
+    char magic[8];
+    uint64_t rows;
+    uint64_t cols;
+};
+
+/*
+An open column store file. Reads go through 'pread' so that a store can be shared by callers
+without any seek state.
+*/
+struct ColumnStore
+{
+    int fd;
+    struct dim dim;
+};
+
+typedef struct ColumnStore ColumnStore;
+
+/*
+Read-only view of a dataset as a set of columns. Training code only ever asks for a contiguous
+range of rows of one column at a time, which lets the same code run over a file on disk or over
+data that is already in memory.
+*/
+typedef struct ColumnSource ColumnSource;
+
+struct ColumnSource
+{
+    struct dim dim;    // Rows visible through this source and total columns.
+    size_t row_offset; // Global index of the first visible row.
+    size_t total_rows; // Rows of the whole dataset, of which this source may only show a shard.
+
+    // Copies 'count' values of column 'col' starting at visible row 'begin' into 'out'.
+    void (*read_column)(const ColumnSource *src, size_t col, size_t begin, size_t count, double *out);
+    const void *handle;
+};
+
+/*
+Converts the csv file at 'csv_file' into a column store at 'store_file'. The csv is read twice,
+once to find its dimensions and once to transpose it, and never holds more than roughly
+'mem_budget' bytes of it in memory at a time.
+*/
+void csv_to_colstore(const char *csv_file, const char *store_file, size_t mem_budget);
+
+/*
+Opens the column store at 'store_file' and validates its header. Exits on error.
+*/
+ColumnStore colstore_open(const char *store_file);
+
+/*
+Closes a column store opened with 'colstore_open'.
+*/
+void colstore_close(ColumnStore *store);
+
+/*
+Returns a ColumnSource that reads all rows of 'store' from disk.
+*/
+ColumnSource column_source_from_store(const ColumnStore *store);
+
+/*
+Returns a ColumnSource over 'dim.rows' rows stored row-major in 'data', which are the rows
+[row_offset, row_offset + dim.rows) of a dataset of 'total_rows' rows.
+*/
+ColumnSource column_source_from_rows(const double *data, struct dim dim, size_t row_offset, size_t total_rows);
+
+/*
+Computes the contiguous shard [*begin, *begin + *count) of 'rows' rows owned by 'part' out of
+'parts', spreading the remainder over the first parts.
+*/
+void shard_rows(size_t rows, int part, int parts, size_t *begin, size_t *count);
+
+/*
+Returns a view of the store source 'src' restricted to the shard of its rows owned by 'part' out of
+'parts'. In-memory sources only hold their own rows and are created per shard instead.
+*/
+ColumnSource column_source_shard(const ColumnSource *src, int part, int parts);
+
+/*
+Reads every row visible through 'src' into a new row-major array of 'src->dim.rows' *
+'src->dim.cols' values, one column at a time through a buffer of one column. Exits if it can't be
+allocated.
+*/
+double *column_source_load_rows(const ColumnSource *src);
+
+#endif // colstore_h
@@ -11,9 +11,6 @@
 #include "data.h"
 #include "log.h"
 
-// Set to 1 if your CSV has a header row, 0 otherwise
-#define CSV_HAS_HEADER 1
-
 // Debug macro for easier debug output
 #define DEBUG_PRINT(fmt, ...) \
     do { if (DEBUG) fprintf(stderr, fmt, __VA_ARGS__); } while (0)
@@ -189,3 +186,20 @@ void pivot_data(const double *data, const struct dim csv_dim, double ***pivoted_
         for (size_t j = 0; j < csv_dim.cols; ++j)
             (*pivoted_data_p)[i][j] = data[(i * csv_dim.cols) + j];
 }
+
+size_t count_classes(double **data, size_t rows, size_t cols)
+{
+    size_t n_classes = 0;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        double class_label = data[i][cols - 1];
+        if (class_label < 0 || class_label >= INT_MAX || class_label != (double)(int)class_label)
+        {
+            printf("Error: class target values must be integers >= 0, row %zu has: %f\n", i, class_label);
+            exit(-1);
+        }
+        if ((size_t)class_label + 1 > n_classes)
+            n_classes = (size_t)class_label + 1;
+    }
+    return n_classes;
+}
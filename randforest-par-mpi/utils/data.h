@@ -16,6 +16,9 @@
 #include <limits.h>
 #include "utils.h"
 
+// Set to 1 if your CSV has a header row, 0 otherwise
+#define CSV_HAS_HEADER 1
+
 /*
 Struct for parsed data dimensions.
 */
@@ -50,4 +53,10 @@ Pivots and transforms the data in 'data' array into a two-dimensional array of s
 */
 void pivot_data(const double *data, const struct dim csv_dim, double ***pivoted_data_p);
 
+/*
+Returns the number of classes of the class target column 'cols - 1' of the 'rows' rows of 'data',
+i.e. the largest class value + 1. Exits unless every class value is a non-negative integer.
+*/
+size_t count_classes(double **data, size_t rows, size_t cols);
+
 #endif // data_h
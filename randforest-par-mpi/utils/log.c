@@ -8,12 +8,42 @@
 #include <stdarg.h>
 #include "utils.h"
 
+static FILE *log_stream = NULL;
+static char *log_buffer = NULL;
 
-void log_if_level(int level, const char *format, ...) {
-    if (log_level > level) {
-        va_list args;
-        va_start(args, format);
-        vprintf(format, args);
-        va_end(args);
+void log_write(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    // Streams lock internally, so worker threads can log concurrently.
+    vfprintf(log_stream ? log_stream : stdout, format, args);
+    va_end(args);
+}
+
+void log_open_rank_file(const char *prefix, int rank) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.%d.log", prefix, rank);
+
+    log_close();
+    log_stream = fopen(path, "w");
+    log_buffer = malloc(LOG_BUFFER_BYTES);
+    if (log_stream == NULL || log_buffer == NULL) {
+        printf("Error: can't create log file: %s\n", path);
+        exit(-1);
+    }
+    setvbuf(log_stream, log_buffer, _IOFBF, LOG_BUFFER_BYTES);
+
+    static int registered = 0;
+    if (!registered) {
+        atexit(log_close);
+        registered = 1;
+    }
+}
+
+void log_close(void) {
+    if (log_stream) {
+        fclose(log_stream);
+        log_stream = NULL;
     }
-}   
\ No newline at end of file
+    free(log_buffer);
+    log_buffer = NULL;
+}
@@ -13,7 +13,49 @@
 #include <string.h>
 #include <limits.h>
 #include "utils.h"
-void log_if_level(int level, const char *format, ...);
 
+/*
+Messages of level 'LOG_MAX_LEVEL' and above are compiled out, together with the check of
+'log_level', so that the debug messages of the split search cost nothing in builds that don't need
+them. The default keeps every level; 'make LOG_MAX_LEVEL=1' only keeps the level 0 messages that
+the default '--log_level 1' prints.
+*/
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL 3
+#endif
+
+/*
+Whether messages of 'level' are printed, i.e. compiled in and below the runtime 'log_level'.
+*/
+#define log_enabled(level) ((level) < LOG_MAX_LEVEL && log_level > (level))
+
+/*
+Writes the printf style message to the log if 'log_enabled(level)'. The arguments are only
+evaluated when it is.
+*/
+#define log_if_level(level, ...)        \
+    do                                  \
+    {                                   \
+        if (log_enabled(level))         \
+            log_write(__VA_ARGS__);     \
+    } while (0)
+
+/*
+Writes a message to this process' log file if 'log_open_rank_file' opened one, to stdout otherwise.
+*/
+void log_write(const char *format, ...);
+
+/*
+Sends the messages of this process to '<prefix>.<rank>.log' instead of stdout, through a buffer of
+LOG_BUFFER_BYTES that is written out whenever it fills up and when the process exits. Ranks then
+neither interleave their lines nor wait on a shared stdout. Exits if the file can't be created.
+*/
+#define LOG_BUFFER_BYTES (1 << 20)
+void log_open_rank_file(const char *prefix, int rank);
+
+/*
+Flushes and closes the log file, if any, so that later messages go to stdout again.
+*/
+void log_close(void);
 
 #endif // log_h
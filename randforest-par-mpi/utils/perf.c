@@ -0,0 +1,315 @@
+/*
+Hardware performance counters of the hot phases of training.
+*/
+
+// syscall() needs the default POSIX and BSD extensions.
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <mpi.h>
+#include "perf.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *phase_names[N_PERF_PHASES] = {"load", "split_search", "partition", "predict"};
+
+static int perf_on = 0;
+static uint64_t phase_counts[N_PERF_PHASES][N_PERF_COUNTERS];
+static uint64_t phase_enabled[N_PERF_PHASES]; // Nanoseconds the counters were enabled and running.
+static uint64_t phase_running[N_PERF_PHASES];
+static int available[N_PERF_COUNTERS]; // Counters the first thread managed to open.
+
+#ifdef __linux__
+
+/*
+The counters of one thread, read all at once through their group leader, the cycles counter.
+*/
+typedef struct PerfGroup
+{
+    int leader;
+    int n_members;
+    int member[N_PERF_COUNTERS]; // Position of each counter in the group's read, -1 if not open.
+    int fds[N_PERF_COUNTERS];
+} PerfGroup;
+
+static pthread_key_t group_key;
+static pthread_once_t group_once = PTHREAD_ONCE_INIT;
+
+static void close_group(void *arg)
+{
+    PerfGroup *group = arg;
+    for (int c = 0; c < N_PERF_COUNTERS; ++c)
+        if (group->fds[c] >= 0)
+            close(group->fds[c]);
+    free(group);
+}
+
+static void create_group_key(void)
+{
+    pthread_key_create(&group_key, close_group);
+}
+
+static int open_counter(uint32_t type, uint64_t config, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // The calling thread only, on whatever CPU it runs.
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+Opens the counters of the calling thread, or returns NULL if it can't count cycles.
+*/
+static PerfGroup *open_group(void)
+{
+    static const uint32_t types[N_PERF_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    static const uint64_t configs[N_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+    PerfGroup *group = malloc(sizeof(PerfGroup));
+    group->n_members = 0;
+    for (int c = 0; c < N_PERF_COUNTERS; ++c)
+    {
+        group->fds[c] = open_counter(types[c], configs[c], c == 0 ? -1 : group->fds[0]);
+        group->member[c] = group->fds[c] >= 0 ? group->n_members++ : -1;
+        if (c == 0 && group->fds[0] < 0)
+        {
+            free(group);
+            return NULL;
+        }
+    }
+    group->leader = group->fds[0];
+    ioctl(group->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return group;
+}
+
+/*
+Counters of the calling thread, opened on first use. NULL if they can't be opened.
+*/
+static PerfGroup *thread_group(void)
+{
+    pthread_once(&group_once, create_group_key);
+    PerfGroup *group = pthread_getspecific(group_key);
+    if (group == NULL)
+    {
+        group = open_group();
+        pthread_setspecific(group_key, group);
+    }
+    return group;
+}
+
+static int read_group(PerfGroup *group, PerfSample *sample)
+{
+    // PERF_FORMAT_GROUP: the number of members, the times enabled and running, then their values.
+    uint64_t buffer[3 + N_PERF_COUNTERS];
+    ssize_t expected = (ssize_t)((3 + group->n_members) * sizeof(uint64_t));
+    if (read(group->leader, buffer, sizeof(buffer)) < expected)
+        return 0;
+    sample->enabled = buffer[1];
+    sample->running = buffer[2];
+    for (int c = 0; c < N_PERF_COUNTERS; ++c)
+        sample->values[c] = group->member[c] >= 0 ? buffer[3 + group->member[c]] : 0;
+    return 1;
+}
+
+int perf_enable(int rank)
+{
+    // Counting must be on for all ranks or none, since the report gathers the counters of all.
+    PerfGroup *group = thread_group();
+    int counting = group != NULL, all_counting;
+    MPI_Allreduce(&counting, &all_counting, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!all_counting)
+    {
+        if (rank == 0)
+            printf("Warning: hardware counters are not available (perf_event_open failed), --perf_counters ignored\n");
+        return 0;
+    }
+    for (int c = 0; c < N_PERF_COUNTERS; ++c)
+        available[c] = group->member[c] >= 0;
+    perf_on = 1;
+    return 1;
+}
+
+void perf_begin(PerfSample *sample)
+{
+    sample->valid = 0;
+    if (!perf_on)
+        return;
+    PerfGroup *group = thread_group();
+    sample->valid = group && read_group(group, sample);
+}
+
+void perf_add(PerfPhase phase, const PerfSample *sample)
+{
+    if (!sample->valid)
+        return;
+    PerfSample now;
+    if (!read_group(thread_group(), &now))
+        return;
+    for (int c = 0; c < N_PERF_COUNTERS; ++c)
+        __sync_fetch_and_add(&phase_counts[phase][c], (uint64_t)(perf_delta(sample, &now, c) + 0.5));
+    __sync_fetch_and_add(&phase_enabled[phase], now.enabled - sample->enabled);
+    __sync_fetch_and_add(&phase_running[phase], now.running - sample->running);
+}
+
+#else
+
+int perf_enable(int rank)
+{
+    if (rank == 0)
+        printf("Warning: hardware counters need Linux perf_event_open, --perf_counters ignored\n");
+    return 0;
+}
+
+void perf_begin(PerfSample *sample)
+{
+    sample->valid = 0;
+}
+
+void perf_add(PerfPhase phase, const PerfSample *sample)
+{
+    (void)phase;
+    (void)sample;
+}
+
+#endif
+
+int perf_enabled(void)
+{
+    return perf_on;
+}
+
+double perf_delta(const PerfSample *before, const PerfSample *after, PerfCounter counter)
+{
+    double count = (double)(after->values[counter] - before->values[counter]);
+    uint64_t enabled = after->enabled - before->enabled;
+    uint64_t running = after->running - before->running;
+    // A group that never got onto the PMU counted nothing, there is nothing to scale.
+    if (running > 0 && running < enabled)
+        count *= (double)enabled / (double)running;
+    return count;
+}
+
+double *perf_gather(void)
+{
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    double local[N_PERF_PHASES * PERF_GATHERED];
+    for (int p = 0; p < N_PERF_PHASES; ++p)
+    {
+        for (int c = 0; c < N_PERF_COUNTERS; ++c)
+            local[p * PERF_GATHERED + c] = available[c] ? (double)phase_counts[p][c] : -1.0;
+        local[p * PERF_GATHERED + PERF_RUNNING] =
+            phase_enabled[p] > 0 ? (double)phase_running[p] / (double)phase_enabled[p] : 1.0;
+    }
+
+    double *all = rank == 0 ? malloc(size * N_PERF_PHASES * PERF_GATHERED * sizeof(double)) : NULL;
+    MPI_Gather(local, N_PERF_PHASES * PERF_GATHERED, MPI_DOUBLE,
+               all, N_PERF_PHASES * PERF_GATHERED, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    return all;
+}
+
+/*
+'misses' per thousand 'instructions', or a negative value if either is unavailable.
+*/
+static double per_kilo_instruction(double misses, double instructions)
+{
+    return misses >= 0.0 && instructions > 0.0 ? 1000.0 * misses / instructions : -1.0;
+}
+
+void perf_print(const double *counters, int size)
+{
+    int multiplexed = 0;
+    printf("hardware counters per rank (user space, MPKI = misses per 1000 instructions):\n");
+    printf("  %-13s %4s %14s %14s %6s %10s %10s %10s %6s\n",
+           "phase", "rank", "cycles", "instructions", "IPC", "LLC MPKI", "br MPKI", "dTLB MPKI", "run%");
+    for (int p = 0; p < N_PERF_PHASES; ++p)
+    {
+        for (int r = 0; r < size; ++r)
+        {
+            const double *v = counters + (r * N_PERF_PHASES + p) * PERF_GATHERED;
+            double ipc = v[PERF_CYCLES] > 0.0 && v[PERF_INSTRUCTIONS] >= 0.0 ? v[PERF_INSTRUCTIONS] / v[PERF_CYCLES] : -1.0;
+            double mpki[3] = {per_kilo_instruction(v[PERF_LLC_MISSES], v[PERF_INSTRUCTIONS]),
+                              per_kilo_instruction(v[PERF_BRANCH_MISSES], v[PERF_INSTRUCTIONS]),
+                              per_kilo_instruction(v[PERF_DTLB_MISSES], v[PERF_INSTRUCTIONS])};
+
+            printf("  %-13s %4d %14.0f %14.0f", phase_names[p], r, v[PERF_CYCLES], v[PERF_INSTRUCTIONS]);
+            if (ipc >= 0.0)
+                printf(" %6.2f", ipc);
+            else
+                printf(" %6s", "n/a");
+            for (int m = 0; m < 3; ++m)
+            {
+                if (mpki[m] >= 0.0)
+                    printf(" %10.3f", mpki[m]);
+                else
+                    printf(" %10s", "n/a");
+            }
+            // Counts of a phase the counters only ran for part of are scaled estimates.
+            if (v[PERF_RUNNING] < 1.0)
+            {
+                printf(" %5.1f*\n", 100.0 * v[PERF_RUNNING]);
+                multiplexed = 1;
+            }
+            else
+                printf(" %6.1f\n", 100.0);
+        }
+    }
+    if (multiplexed)
+        printf("  * multiplexed: counted for run%% of the phase and scaled up to all of it\n");
+}
+
+void perf_write_json(FILE *json, const double *counters, int size)
+{
+    static const char *counter_names[N_PERF_COUNTERS] = {
+        "cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses"};
+
+    fprintf(json, "[\n");
+    for (int p = 0; p < N_PERF_PHASES; ++p)
+    {
+        fprintf(json, "    {\"name\": \"%s\"", phase_names[p]);
+        for (int c = 0; c < N_PERF_COUNTERS; ++c)
+        {
+            // One value per rank, null where the counter is unavailable.
+            fprintf(json, ", \"%s\": [", counter_names[c]);
+            for (int r = 0; r < size; ++r)
+            {
+                double v = counters[(r * N_PERF_PHASES + p) * PERF_GATHERED + c];
+                if (v >= 0.0)
+                    fprintf(json, "%s%.0f", r ? ", " : "", v);
+                else
+                    fprintf(json, "%snull", r ? ", " : "");
+            }
+            fprintf(json, "]");
+        }
+        // Below 1 where the counters were multiplexed and the counts above are scaled estimates.
+        fprintf(json, ", \"running_fraction\": [");
+        for (int r = 0; r < size; ++r)
+            fprintf(json, "%s%.4f", r ? ", " : "", counters[(r * N_PERF_PHASES + p) * PERF_GATHERED + PERF_RUNNING]);
+        fprintf(json, "]");
+        fprintf(json, "}%s\n", p + 1 < N_PERF_PHASES ? "," : "");
+    }
+    fprintf(json, "  ]");
+}
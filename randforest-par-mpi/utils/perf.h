@@ -0,0 +1,106 @@
+/*
+Hardware performance counters of the hot phases of training, read with 'perf_event_open' on Linux.
+Every thread counts its own events, which are summed per phase and rank and reported on rank 0 next
+to the phase timers. On other systems, or where the kernel denies access to the counters, the
+counters stay off and training is unaffected.
+*/
+
+#ifndef perf_h
+#define perf_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Counted phases. 'PERF_PARTITION' runs inside 'PERF_SPLIT_SEARCH', which counts the whole split
+search of a node including the partition of its rows.
+*/
+typedef enum PerfPhase
+{
+    PERF_LOAD,         // Reading the csv file.
+    PERF_SPLIT_SEARCH, // 'calculate_best_data_split'.
+    PERF_PARTITION,    // Partitioning the rows of a node between its halves.
+    PERF_PREDICT,      // Evaluating the testing fold.
+    N_PERF_PHASES
+} PerfPhase;
+
+typedef enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    N_PERF_COUNTERS
+} PerfCounter;
+
+/*
+Counter values read at the start of a phase by 'perf_begin', with the nanoseconds the counters had
+been enabled and actually running on the PMU by then. The two times differ once the kernel has to
+multiplex the counters with other events.
+*/
+typedef struct PerfSample
+{
+    uint64_t values[N_PERF_COUNTERS];
+    uint64_t enabled;
+    uint64_t running;
+    int valid;
+} PerfSample;
+
+/*
+Turns the counters on for every thread of this process, which opens its counters the first time it
+counts a phase. Returns 0, after printing a warning on rank 0, if any rank can't count cycles.
+Counters other than cycles that the CPU lacks are reported as unavailable. Collective.
+*/
+int perf_enable(int rank);
+
+/*
+Reads the counters of the calling thread into 'sample' at the start of a phase. Does nothing while
+the counters are off.
+*/
+void perf_begin(PerfSample *sample);
+
+/*
+Events of 'counter' between two samples of the same thread. If the counters were multiplexed in
+between, the count is scaled up by the time they were enabled over the time they were running, as
+'perf stat' does.
+*/
+double perf_delta(const PerfSample *before, const PerfSample *after, PerfCounter counter);
+
+/*
+Adds the events of the calling thread since 'perf_begin' filled 'sample' to 'phase', scaled as by
+'perf_delta'.
+*/
+void perf_add(PerfPhase phase, const PerfSample *sample);
+
+/*
+Whether 'perf_enable' turned the counters on.
+*/
+int perf_enabled(void);
+
+/*
+Values gathered per rank and phase by 'perf_gather': the counters, then at 'PERF_RUNNING' the
+fraction of the phase the counters were running on the PMU, below 1 if they were multiplexed.
+*/
+#define PERF_RUNNING N_PERF_COUNTERS
+#define PERF_GATHERED (N_PERF_COUNTERS + 1)
+
+/*
+Gathers the counters of every rank of MPI_COMM_WORLD. Rank 0 gets 'size * N_PERF_PHASES *
+PERF_GATHERED' values, rank 'r' phase 'p' value 'c' at '(r * N_PERF_PHASES + p) * PERF_GATHERED +
+c', a negative value for an unavailable counter. Other ranks get NULL. Collective.
+*/
+double *perf_gather(void);
+
+/*
+Prints the counters of every rank and phase gathered by 'perf_gather', with the instructions per
+cycle and the misses per thousand instructions. Multiplexed counts are marked as estimates.
+*/
+void perf_print(const double *counters, int size);
+
+/*
+Writes the counters gathered by 'perf_gather' as the value of a JSON object member.
+*/
+void perf_write_json(FILE *json, const double *counters, int size);
+
+#endif // perf_h
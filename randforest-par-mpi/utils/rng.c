@@ -0,0 +1,72 @@
+/*
+Counter based random number generator (Philox4x32-10, Salmon et al., SC'11).
+*/
+
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/*
+Encrypts 'counter' with 'key', giving 4 independent uniformly distributed words in 'out'.
+*/
+static void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int round = 0; round < PHILOX_ROUNDS; ++round)
+    {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+void rng_init(RandomState *rng, uint32_t seed, uint32_t fold, uint32_t tree, uint64_t node)
+{
+    rng->key[0] = seed;
+    rng->key[1] = fold;
+    rng->counter[0] = 0;
+    rng->counter[1] = tree;
+    rng->counter[2] = (uint32_t)node;
+    rng->counter[3] = (uint32_t)(node >> 32);
+    rng->used = 4;
+}
+
+uint32_t rng_next(RandomState *rng)
+{
+    if (rng->used == 4)
+    {
+        philox4x32(rng->counter, rng->key, rng->block);
+        rng->counter[0]++;
+        rng->used = 0;
+    }
+    return rng->block[rng->used++];
+}
+
+RandomState rng_child(const RandomState *rng, int side)
+{
+    // Heap numbering from the root 0: children of 'n' are 2n + 1 and 2n + 2. Trees deeper than 63
+    // levels wrap around, which only makes distant nodes share a stream.
+    uint64_t node = ((uint64_t)rng->counter[3] << 32) | rng->counter[2];
+
+    RandomState child;
+    rng_init(&child, rng->key[0], rng->key[1], rng->counter[1], 2 * node + 1 + (uint64_t)side);
+    return child;
+}
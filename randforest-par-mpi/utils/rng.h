@@ -0,0 +1,40 @@
+/*
+Counter based random number generator (Philox4x32-10), used instead of 'rand()'/'srand()'. A
+generator is fully determined by its key (seed, fold, tree, node) and a draw counter, so any
+process or thread can recreate the numbers of any node without shared state or communication.
+*/
+
+#ifndef rng_h
+#define rng_h
+
+#include <stdint.h>
+
+struct RandomState
+{
+    uint32_t key[2];     // Seed and fold.
+    uint32_t counter[4]; // Block index, tree, node (low and high word).
+    uint32_t block[4];   // Last generated block of 4 numbers.
+    unsigned int used;   // Numbers of 'block' already returned.
+};
+
+typedef struct RandomState RandomState;
+
+/*
+Initializes 'rng' to the stream of node 'node' of tree 'tree' in fold 'fold' of a run with seed
+'seed'. Root nodes are node 0, see 'rng_child' for the others. Equal keys give equal sequences.
+*/
+void rng_init(RandomState *rng, uint32_t seed, uint32_t fold, uint32_t tree, uint64_t node);
+
+/*
+Returns the next pseudo random number of 'rng' in [0, UINT32_MAX].
+*/
+uint32_t rng_next(RandomState *rng);
+
+/*
+Returns the generator of the left ('side' = 0) or right ('side' = 1) child of the node of 'rng'.
+Nodes are numbered like a binary heap, so a node's stream only depends on its path from the root
+and not on the order in which, or the thread by which, the tree is built.
+*/
+RandomState rng_child(const RandomState *rng, int side);
+
+#endif // rng_h
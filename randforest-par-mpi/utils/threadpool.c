@@ -0,0 +1,275 @@
+/*
+Fixed size pool of worker threads with one task deque per worker and work stealing.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threadpool.h"
+
+typedef struct PoolTask
+{
+    ThreadTask task;
+    void *arg;
+    TaskGroup *group;
+} PoolTask;
+
+/*
+Growable ring buffer of tasks. The owner pushes and pops at the bottom (newest), thieves take from
+the top (oldest), which are the largest pieces of work when tasks spawn tasks recursively.
+*/
+typedef struct TaskDeque
+{
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    size_t capacity;
+    size_t top;   // Index of the oldest task.
+    size_t count;
+} TaskDeque;
+
+typedef struct Worker
+{
+    ThreadPool *pool;
+    int id;
+} Worker;
+
+struct ThreadPool
+{
+    pthread_t *threads;
+    Worker *workers;
+    int n_threads;
+
+    // One deque per worker, plus a last one receiving the tasks submitted from outside the pool.
+    TaskDeque *deques;
+    pthread_key_t worker_key; // Points into 'workers' on worker threads, NULL elsewhere.
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;      // Broadcast when a task is queued, a group completes or the pool stops.
+    long queued;              // Tasks sitting in any deque.
+    int stopping;
+};
+
+static long load_counter(long *value)
+{
+    return __sync_add_and_fetch(value, 0);
+}
+
+static void deque_push(TaskDeque *deque, PoolTask task)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity)
+    {
+        size_t capacity = deque->capacity ? 2 * deque->capacity : 16;
+        PoolTask *tasks = malloc(capacity * sizeof(PoolTask));
+        if (tasks == NULL)
+        {
+            printf("Error: failed to grow task deque to %zu tasks\n", capacity);
+            exit(1);
+        }
+        for (size_t i = 0; i < deque->count; ++i)
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->top = 0;
+    }
+    deque->tasks[(deque->top + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/*
+Takes the newest ('newest' = 1, owner) or the oldest ('newest' = 0, thief) task of 'deque'.
+Returns 0 if the deque is empty.
+*/
+static int deque_take(TaskDeque *deque, int newest, PoolTask *task)
+{
+    int taken = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0)
+    {
+        if (newest)
+            *task = deque->tasks[(deque->top + deque->count - 1) % deque->capacity];
+        else
+        {
+            *task = deque->tasks[deque->top];
+            deque->top = (deque->top + 1) % deque->capacity;
+        }
+        deque->count--;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+/*
+Index of the calling worker thread in 'pool', -1 if it is not one of its workers.
+*/
+static int current_worker(ThreadPool *pool)
+{
+    const Worker *worker = pthread_getspecific(pool->worker_key);
+    return worker ? worker->id : -1;
+}
+
+/*
+Finds a task for worker 'self' (-1 for a thread outside the pool): its own newest task first,
+otherwise the oldest task of the next non empty deque. Returns 0 if every deque is empty.
+*/
+static int find_task(ThreadPool *pool, int self, PoolTask *task)
+{
+    int n_deques = pool->n_threads + 1;
+    if (self >= 0 && deque_take(&pool->deques[self], 1, task))
+        goto found;
+
+    for (int i = 1; i <= n_deques; ++i)
+    {
+        int victim = (self + i + n_deques) % n_deques;
+        if (victim != self && deque_take(&pool->deques[victim], 0, task))
+            goto found;
+    }
+    return 0;
+
+found:
+    __sync_sub_and_fetch(&pool->queued, 1);
+    return 1;
+}
+
+static void run_task(ThreadPool *pool, PoolTask *task)
+{
+    task->task(task->arg);
+
+    if (__sync_sub_and_fetch(&task->group->pending, 1) == 0)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *worker = arg;
+    ThreadPool *pool = worker->pool;
+
+    pthread_setspecific(pool->worker_key, worker);
+
+    for (;;)
+    {
+        PoolTask task;
+        if (find_task(pool, worker->id, &task))
+        {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (load_counter(&pool->queued) == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        int stop = pool->stopping && load_counter(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+ThreadPool *thread_pool_create(int n_threads)
+{
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    pool->threads = malloc(n_threads * sizeof(pthread_t));
+    pool->workers = malloc(n_threads * sizeof(Worker));
+    pool->deques = calloc(n_threads + 1, sizeof(TaskDeque));
+    pool->n_threads = n_threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_key_create(&pool->worker_key, NULL);
+
+    for (int i = 0; i <= n_threads; ++i)
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+    for (int i = 0; i < n_threads; ++i)
+    {
+        pool->workers[i] = (Worker){.pool = pool, .id = i};
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]) != 0)
+        {
+            printf("Error: failed to start worker thread %d of %d\n", i, n_threads);
+            exit(1);
+        }
+    }
+    return pool;
+}
+
+void thread_pool_submit(ThreadPool *pool, TaskGroup *group, ThreadTask task, void *arg)
+{
+    int self = current_worker(pool);
+    TaskDeque *deque = &pool->deques[self >= 0 ? self : pool->n_threads];
+
+    __sync_add_and_fetch(&group->pending, 1);
+    deque_push(deque, (PoolTask){.task = task, .arg = arg, .group = group});
+    __sync_add_and_fetch(&pool->queued, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool *pool, TaskGroup *group)
+{
+    int self = current_worker(pool);
+
+    if (self < 0)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (load_counter(&group->pending) > 0)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    // Help instead of blocking: the tasks of 'group' are either queued, and run here if nobody
+    // else gets to them first, or already running on other workers.
+    while (load_counter(&group->pending) > 0)
+    {
+        PoolTask task;
+        if (find_task(pool, self, &task))
+        {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (load_counter(&group->pending) > 0 && load_counter(&pool->queued) == 0)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+int thread_pool_size(const ThreadPool *pool)
+{
+    return pool->n_threads;
+}
+
+void thread_pool_destroy(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->n_threads; ++i)
+        pthread_join(pool->threads[i], NULL);
+
+    for (int i = 0; i <= pool->n_threads; ++i)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_key_delete(pool->worker_key);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
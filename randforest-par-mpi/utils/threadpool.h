@@ -0,0 +1,55 @@
+/*
+Fixed size pool of worker threads with one task deque per worker. A worker runs the tasks it
+submits itself newest first, and when its own deque is empty it steals the oldest task of another
+worker, so tasks spawned from inside other tasks (such as subtrees of a tree) spread over idle
+workers without going through one shared queue.
+*/
+
+#ifndef threadpool_h
+#define threadpool_h
+
+typedef void (*ThreadTask)(void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+/*
+A set of submitted tasks that can be waited for together. Must be initialized with
+TASK_GROUP_INIT and outlive its tasks.
+*/
+struct TaskGroup
+{
+    long pending; // Tasks submitted to the group that have not completed yet.
+};
+
+typedef struct TaskGroup TaskGroup;
+
+#define TASK_GROUP_INIT {0}
+
+/*
+Starts a pool of 'n_threads' worker threads waiting for tasks.
+*/
+ThreadPool *thread_pool_create(int n_threads);
+
+/*
+Queues 'task(arg)' as part of 'group'. Called from a worker the task goes to the worker's own
+deque, otherwise to a queue shared by all workers.
+*/
+void thread_pool_submit(ThreadPool *pool, TaskGroup *group, ThreadTask task, void *arg);
+
+/*
+Blocks until every task of 'group' has completed. Called from a worker, the worker keeps running
+queued tasks of any group meanwhile instead of blocking, so nested waits can't starve the pool.
+*/
+void thread_pool_wait(ThreadPool *pool, TaskGroup *group);
+
+/*
+Returns the number of worker threads of 'pool'.
+*/
+int thread_pool_size(const ThreadPool *pool);
+
+/*
+Stops the worker threads and frees the pool. Every submitted group must have been waited for.
+*/
+void thread_pool_destroy(ThreadPool *pool);
+
+#endif // threadpool_h
@@ -0,0 +1,291 @@
+/*
+Wall-clock timers of the phases of a run.
+*/
+
+// clock_gettime is POSIX.
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <mpi.h>
+#include "timer.h"
+#include "perf.h"
+#include "utils.h"
+
+static const char *phase_names[N_TIMER_PHASES] = {
+    "parse",
+    "broadcast",
+    "pivot",
+    "presort",
+    "cross_validate",
+    "train",
+    "tree",
+    "predict",
+    "reduce"};
+
+static int64_t phase_ns[N_TIMER_PHASES];
+static int64_t phase_calls[N_TIMER_PHASES];
+
+/*
+A timed interval, relative to the origin of the trace.
+*/
+typedef struct TraceEvent
+{
+    int64_t start;
+    int64_t end;
+    int32_t phase;
+    int32_t thread;
+} TraceEvent;
+
+static TraceEvent *trace_events = NULL; // Ring buffer of TRACE_EVENTS events, NULL when off.
+static int64_t trace_next = 0;          // Events recorded so far, the ring slot is modulo.
+static int64_t trace_origin = 0;
+
+static pthread_key_t thread_key;
+static pthread_once_t thread_once = PTHREAD_ONCE_INIT;
+static long thread_count = 0;
+
+static void create_thread_key(void)
+{
+    pthread_key_create(&thread_key, NULL);
+}
+
+/*
+Small id of the calling thread, numbered in the order the threads first record an event.
+*/
+static int32_t trace_thread(void)
+{
+    pthread_once(&thread_once, create_thread_key);
+    long id = (long)(intptr_t)pthread_getspecific(thread_key);
+    if (id == 0)
+    {
+        id = __sync_add_and_fetch(&thread_count, 1);
+        pthread_setspecific(thread_key, (void *)(intptr_t)id);
+    }
+    return (int32_t)(id - 1);
+}
+
+int64_t timer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void timer_add(TimerPhase phase, int64_t start)
+{
+    int64_t end = timer_now();
+    __sync_fetch_and_add(&phase_ns[phase], end - start);
+    __sync_fetch_and_add(&phase_calls[phase], 1);
+
+    if (trace_events)
+    {
+        int64_t slot = __sync_fetch_and_add(&trace_next, 1) % TRACE_EVENTS;
+        trace_events[slot] = (TraceEvent){start - trace_origin, end - trace_origin, phase, trace_thread()};
+    }
+}
+
+double timer_seconds(TimerPhase phase)
+{
+    return (double)phase_ns[phase] / 1e9;
+}
+
+/*
+Minimum, mean and maximum of the 'n' entries of 'values' spaced 'stride' apart.
+*/
+static void summarize(const double *values, int n, int stride, double *min, double *mean, double *max)
+{
+    *min = *max = values[0];
+    double sum = 0.0;
+    for (int r = 0; r < n; ++r)
+    {
+        double v = values[r * stride];
+        *min = v < *min ? v : *min;
+        *max = v > *max ? v : *max;
+        sum += v;
+    }
+    *mean = sum / n;
+}
+
+static double imbalance(double mean, double max)
+{
+    return mean > 0.0 ? max / mean : 1.0;
+}
+
+static void write_json(const char *json_file, const double *seconds, const double *calls, const double *counters, int size)
+{
+    FILE *json = fopen(json_file, "w");
+    if (json == NULL)
+    {
+        printf("Error: can't create timings file: %s\n", json_file);
+        return;
+    }
+
+    fprintf(json, "{\n  \"ranks\": %d,\n  \"phases\": [\n", size);
+    for (int p = 0; p < N_TIMER_PHASES; ++p)
+    {
+        double min, mean, max, calls_min, calls_mean, calls_max;
+        summarize(seconds + p, size, N_TIMER_PHASES, &min, &mean, &max);
+        summarize(calls + p, size, N_TIMER_PHASES, &calls_min, &calls_mean, &calls_max);
+
+        fprintf(json, "    {\"name\": \"%s\", \"calls\": %.0f, \"min\": %.9f, \"mean\": %.9f, \"max\": %.9f, "
+                      "\"imbalance\": %.6f, \"seconds\": [",
+                phase_names[p], calls_mean * size, min, mean, max, imbalance(mean, max));
+        for (int r = 0; r < size; ++r)
+            fprintf(json, "%s%.9f", r ? ", " : "", seconds[r * N_TIMER_PHASES + p]);
+        fprintf(json, "]}%s\n", p + 1 < N_TIMER_PHASES ? "," : "");
+    }
+    fprintf(json, "  ]");
+    if (counters)
+    {
+        fprintf(json, ",\n  \"counters\": ");
+        perf_write_json(json, counters, size);
+    }
+    fprintf(json, "\n}\n");
+    fclose(json);
+}
+
+void timer_report(const char *json_file)
+{
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    double local[2 * N_TIMER_PHASES];
+    for (int p = 0; p < N_TIMER_PHASES; ++p)
+    {
+        local[p] = timer_seconds(p);
+        local[N_TIMER_PHASES + p] = (double)phase_calls[p];
+    }
+
+    double *all = rank == 0 ? malloc(size * 2 * N_TIMER_PHASES * sizeof(double)) : NULL;
+    MPI_Gather(local, 2 * N_TIMER_PHASES, MPI_DOUBLE, all, 2 * N_TIMER_PHASES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    double *counters = perf_enabled() ? perf_gather() : NULL;
+    if (rank != 0)
+        return;
+
+    // Split the gathered rows into the seconds and the calls of each rank.
+    double *seconds = malloc(size * N_TIMER_PHASES * sizeof(double));
+    double *calls = malloc(size * N_TIMER_PHASES * sizeof(double));
+    for (int r = 0; r < size; ++r)
+    {
+        for (int p = 0; p < N_TIMER_PHASES; ++p)
+        {
+            seconds[r * N_TIMER_PHASES + p] = all[r * 2 * N_TIMER_PHASES + p];
+            calls[r * N_TIMER_PHASES + p] = all[r * 2 * N_TIMER_PHASES + N_TIMER_PHASES + p];
+        }
+    }
+
+    if (log_level > 0)
+    {
+        printf("phase timings over %d ranks (wall-clock seconds):\n", size);
+        printf("  %-16s %10s %10s %10s %10s %10s\n", "phase", "calls", "min", "mean", "max", "imbalance");
+        for (int p = 0; p < N_TIMER_PHASES; ++p)
+        {
+            double min, mean, max, calls_min, calls_mean, calls_max;
+            summarize(seconds + p, size, N_TIMER_PHASES, &min, &mean, &max);
+            summarize(calls + p, size, N_TIMER_PHASES, &calls_min, &calls_mean, &calls_max);
+            printf("  %-16s %10.0f %10.4f %10.4f %10.4f %10.2f\n",
+                   phase_names[p], calls_mean * size, min, mean, max, imbalance(mean, max));
+        }
+        if (counters)
+            perf_print(counters, size);
+    }
+    if (json_file)
+        write_json(json_file, seconds, calls, counters, size);
+
+    free(counters);
+    free(all);
+    free(seconds);
+    free(calls);
+}
+
+void trace_enable(void)
+{
+    trace_events = malloc(TRACE_EVENTS * sizeof(TraceEvent));
+    if (trace_events == NULL)
+    {
+        printf("Error: failed to allocate %d trace events\n", TRACE_EVENTS);
+        exit(-1);
+    }
+    trace_thread();
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    trace_origin = timer_now();
+}
+
+void trace_write(const char *trace_file)
+{
+    if (trace_events == NULL)
+        return;
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // The ring holds the last 'count' events, the oldest one at slot 'first'.
+    int count = trace_next < TRACE_EVENTS ? (int)trace_next : TRACE_EVENTS;
+    int first = trace_next < TRACE_EVENTS ? 0 : (int)(trace_next % TRACE_EVENTS);
+    TraceEvent *ordered = malloc((count + 1) * sizeof(TraceEvent));
+    for (int i = 0; i < count; ++i)
+        ordered[i] = trace_events[(first + i) % TRACE_EVENTS];
+
+    int *counts = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+    int *displs = rank == 0 ? malloc(size * sizeof(int)) : NULL;
+    int bytes = count * (int)sizeof(TraceEvent);
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    char *all = NULL;
+    if (rank == 0)
+    {
+        long total = 0;
+        for (int r = 0; r < size; ++r)
+        {
+            displs[r] = (int)total;
+            total += counts[r];
+        }
+        all = malloc(total + 1);
+    }
+    MPI_Gatherv(ordered, bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        FILE *trace = fopen(trace_file, "w");
+        if (trace == NULL)
+            printf("Error: can't create trace file: %s\n", trace_file);
+        else
+        {
+            fprintf(trace, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            for (int r = 0; r < size; ++r)
+                fprintf(trace, "%s  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"rank %d\"}}",
+                        r ? ",\n" : "", r, r);
+
+            int separator = size > 0;
+            for (int r = 0; r < size; ++r)
+            {
+                const TraceEvent *events = (const TraceEvent *)(all + displs[r]);
+                for (int i = 0; i < counts[r] / (int)sizeof(TraceEvent); ++i)
+                {
+                    // Complete events, timestamps and durations in microseconds.
+                    fprintf(trace, "%s  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                            separator ? ",\n" : "",
+                            phase_names[events[i].phase],
+                            r,
+                            events[i].thread,
+                            (double)events[i].start / 1e3,
+                            (double)(events[i].end - events[i].start) / 1e3);
+                    separator = 1;
+                }
+            }
+            fprintf(trace, "\n]}\n");
+            fclose(trace);
+        }
+    }
+
+    free(ordered);
+    free(counts);
+    free(displs);
+    free(all);
+}
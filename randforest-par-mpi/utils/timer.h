@@ -0,0 +1,77 @@
+/*
+Wall-clock timers of the phases of a run. Every rank accumulates its own time per phase, and the
+timers of all ranks are gathered on rank 0 at the end of the run, which shows both where the time
+goes and how evenly it is spread over the ranks. Optionally every timed interval is also recorded
+as a trace event, for a timeline of all ranks and threads.
+*/
+
+#ifndef timer_h
+#define timer_h
+
+#include <stdint.h>
+
+/*
+Phases nest: 'PHASE_TREE' and 'PHASE_REDUCE' run inside 'PHASE_TRAIN' and 'PHASE_PREDICT', which
+run inside 'PHASE_CROSS_VALIDATE'. Trees built by worker threads add their time concurrently, so
+'PHASE_TREE' may exceed the wall time of 'PHASE_TRAIN'.
+*/
+typedef enum TimerPhase
+{
+    PHASE_PARSE,          // Reading the csv file, or converting it to a column store.
+    PHASE_BROADCAST,      // Distributing the rows, or the feature bins, to every rank.
+    PHASE_PIVOT,          // Building the row pointers of the in-memory dataset.
+    PHASE_PRESORT,        // Sorting all rows and filtering the order of each fold.
+    PHASE_CROSS_VALIDATE, // The whole cross validation.
+    PHASE_TRAIN,          // Training the trees of each fold.
+    PHASE_TREE,           // Building a single tree.
+    PHASE_PREDICT,        // Evaluating the testing fold.
+    PHASE_REDUCE,         // Collectives of the split search, the histograms and the votes.
+    N_TIMER_PHASES
+} TimerPhase;
+
+/*
+Monotonic wall-clock time in nanoseconds. Unlike 'MPI_Wtime' it may be read by any thread.
+*/
+int64_t timer_now(void);
+
+/*
+Adds the time elapsed since 'start', a reading of 'timer_now', to 'phase' and counts one call.
+Safe to call from several threads at once.
+*/
+void timer_add(TimerPhase phase, int64_t start);
+
+/*
+Seconds accumulated by 'phase' on this rank so far.
+*/
+double timer_seconds(TimerPhase phase);
+
+/*
+Gathers the timers of every rank of MPI_COMM_WORLD on rank 0. Rank 0 prints the calls, the min,
+mean and max seconds over the ranks and the imbalance (max / mean) of every phase when 'log_level'
+is above 0, and writes them with the seconds of each rank as JSON to 'json_file' unless it is NULL.
+The hardware counters of every rank (see 'perf_enable') are printed and written along with them.
+Collective.
+*/
+void timer_report(const char *json_file);
+
+/*
+Events kept per rank by the tracer. Once full, the oldest events are overwritten.
+*/
+#define TRACE_EVENTS 65536
+
+/*
+Starts recording every interval passed to 'timer_add' as a trace event in a ring buffer of
+TRACE_EVENTS events, without any I/O until 'trace_write'. All ranks leave an MPI_Barrier and read
+their clock as the common origin of the timeline, which removes the offsets between the clocks of
+different hosts up to the latency of the barrier. Collective.
+*/
+void trace_enable(void);
+
+/*
+Gathers the trace events of every rank on rank 0, which writes them to 'trace_file' in the Chrome
+trace event format (chrome://tracing, https://ui.perfetto.dev): one process per rank and one
+thread per thread of the rank. Collective, does nothing unless 'trace_enable' was called.
+*/
+void trace_write(const char *trace_file);
+
+#endif // timer_h
@@ -13,6 +13,8 @@
 #include <stdlib.h>
 #include "data.h"
 
+struct Presort;
+
 /*
 Struct to hold information about a current model training run.
 */
@@ -20,12 +22,19 @@ struct ModelContext
 {
     const size_t testingFoldIdx;
     const size_t rowsPerFold;
+    const size_t n_classes; // Class targets are the integers [0, n_classes).
+    const int regression;   // Targets are real values and trees predict their mean.
+    const int extra_trees;  // Split on one random threshold per sampled feature.
+    const size_t quantile_rows; // Nodes with more rows only try 'n_quantiles' thresholds per
+    const size_t n_quantiles;   // feature, 0 tries every distinct value in every node.
+    const struct Presort *presort; // Sort order of the training rows, NULL to sort every node.
 };
 
 typedef struct ModelContext ModelContext;
 
 /*
-The debug log level that can be adjusted via an argument.
+The debug log level that can be adjusted via an argument. Only set before any worker thread is
+started, so threads can read it without synchronization.
 */
 extern int log_level;
 